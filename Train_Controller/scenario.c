@@ -0,0 +1,379 @@
+/*******************************************************************************
+*	scenario.c
+*	Author: Joshua Newhouse
+*
+*	Tab width: 4
+*
+*	Purpose:
+*
+*	This implements the scenario.h interface.
+*
+*	Procedures:
+*
+*	scenario_init		Initializes a Scenario_Engine_ts.
+*	scenario_close		Stops a Scenario_Engine_ts.
+*	scenario_start		Starts a Scenario_ts on a Scenario_Engine_ts.
+*	scenario_notify		Wakes scenarios waiting for a state change.
+*	scenario_command	Sends a command to the target of a Scenario_ts.
+*	scenario_setSpeed	Sets the speed of the target of a Scenario_ts.
+*	scenario_reverse	Reverses the target of a Scenario_ts at the same speed.
+*	executorThread		Runs the scenarios of a Scenario_Engine_ts.
+*	timerPush			Adds a Scenario_ts to the heap of sleeping scenarios.
+*	timerPop			Removes the earliest Scenario_ts from the heap.
+*******************************************************************************/
+#include <windows.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "scenario.h"
+
+static DWORD WINAPI executorThread(void*);
+static void timerPush(Scenario_Engine_ts*, Scenario_ts*);
+static Scenario_ts* timerPop(Scenario_Engine_ts*);
+
+/* Tick counts wrap every 49.7 days, so they are compared by difference */
+#define BEFORE(a, b) ((LONG)((a) - (b)) < 0)
+
+/*******************************************************************************
+*	int scenario_init(Scenario_Engine_ts* engine, int capacity,
+*		scenario_CmdFn send, scenario_RevFn reverse)
+*
+*	Description: Initializes a scenario engine using the arguments passed and
+*		starts its executor thread.
+*
+*	Parameters:
+*
+*	engine		I/O	A pointer to the engine to initialize.
+*	capacity	I/P	The maximum number of scenarios started at once.
+*	send		I/P	The command path scenarios send commands through.
+*	reverse		I/P	The command path scenarios reverse targets through.
+*
+*	Returns:
+*	int			0 if the engine was initialized successfully, 1 otherwise.
+*				Failure may occur due to:
+*					not being able to allocate the heap,
+*					not being able to create the wake event,
+*					not being able to create the executor thread.
+*******************************************************************************/
+int scenario_init(Scenario_Engine_ts* engine, int capacity,
+		scenario_CmdFn send, scenario_RevFn reverse) {
+	if(engine == NULL || capacity < 1) return 1;
+
+	engine->timers = malloc(capacity * sizeof(Scenario_ts*));
+	if(engine->timers == NULL) {
+		fprintf(stderr, "Error allocating scenarios\n");
+		return 1;
+	}
+
+	engine->nTimers = 0;
+	engine->nActive = 0;
+	engine->capacity = capacity;
+	engine->waiting = NULL;
+	engine->notified = 0;
+	engine->run = 1;
+	engine->send = send;
+	engine->reverse = reverse;
+	InitializeCriticalSection(&engine->lock);
+
+	engine->wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if(engine->wakeEvent == NULL) {
+		fprintf(stderr, "Error creating scenario event\n");
+		DeleteCriticalSection(&engine->lock);
+		free(engine->timers);
+		return 1;
+	}
+
+	engine->thread = CreateThread(NULL, 0, executorThread, engine, 0, NULL);
+	if(engine->thread == NULL) {
+		fprintf(stderr, "Error creating scenario thread\n");
+		CloseHandle(engine->wakeEvent);
+		DeleteCriticalSection(&engine->lock);
+		free(engine->timers);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*******************************************************************************
+*	void scenario_close(Scenario_Engine_ts* engine)
+*
+*	Description: Stops the executor thread, waiting for any scenario it is
+*		running to suspend, and then releases the engine.
+*
+*	Parameters:
+*
+*	engine		I/O	A pointer to the engine to close.
+*
+*******************************************************************************/
+void scenario_close(Scenario_Engine_ts* engine) {
+	InterlockedExchange(&engine->run, 0);
+	SetEvent(engine->wakeEvent);
+	WaitForSingleObject(engine->thread, INFINITE);
+
+	CloseHandle(engine->thread);
+	CloseHandle(engine->wakeEvent);
+	DeleteCriticalSection(&engine->lock);
+	free(engine->timers);
+}
+
+/*******************************************************************************
+*	int scenario_start(Scenario_Engine_ts* engine, Scenario_ts* s,
+*		scenario_Fn fn, Target_ts* target, void* ctx, volatile LONG* stop)
+*
+*	Description: Starts the scenario s by adding it to the heap of sleeping
+*		scenarios with a wake time of now, and wakes the executor.
+*
+*	Parameters:
+*
+*	engine		I/O	The engine to run the scenario on.
+*	s			I/O	The scenario to start.
+*	fn			I/P	The routine of the scenario.
+*	target		I/P	The target the scenario controls.
+*	ctx			I/P	A pointer to any data used by the routine.
+*	stop		I/P	A flag stopping the commands of the scenario, or NULL.
+*
+*	Returns:
+*	int			0 if the scenario was started, 1 otherwise.
+*				Failure may occur due to:
+*					the scenario already being started,
+*					the engine already running its capacity of scenarios.
+*******************************************************************************/
+int scenario_start(Scenario_Engine_ts* engine, Scenario_ts* s, scenario_Fn fn,
+		Target_ts* target, void* ctx, volatile LONG* stop) {
+	int ret_val = 1;
+
+	EnterCriticalSection(&engine->lock);
+	if(!s->active && engine->nActive < engine->capacity) {
+		s->fn = fn;
+		s->engine = engine;
+		s->target = target;
+		s->ctx = ctx;
+		s->stop = stop;
+		s->count = 0;
+		s->line = 0;
+		s->active = 1;
+		s->next = NULL;
+		s->wake = GetTickCount();
+		engine->nActive++;
+		timerPush(engine, s);
+		ret_val = 0;
+	}
+	LeaveCriticalSection(&engine->lock);
+
+	if(ret_val == 0)
+		SetEvent(engine->wakeEvent);
+	return ret_val;
+}
+
+/*******************************************************************************
+*	void scenario_notify(Scenario_Engine_ts* engine)
+*
+*	Description: Flags that the waiting scenarios must be resumed and wakes
+*		the executor.  Safe to call from any thread, including from a scenario.
+*
+*	Parameters:
+*
+*	engine		I/O	The engine whose scenarios to wake.
+*
+*******************************************************************************/
+void scenario_notify(Scenario_Engine_ts* engine) {
+	InterlockedExchange(&engine->notified, 1);
+	SetEvent(engine->wakeEvent);
+}
+
+/*******************************************************************************
+*	int scenario_command(Scenario_ts* s, target_CmdType_te cmd, uint8_t data)
+*
+*	Description: Sends the command to the target of s through the command
+*		path of its engine, which skips it if s is stopped.
+*
+*	Parameters:
+*
+*	s			I/P	The scenario sending the command.
+*	cmd			I/P	The command to send.
+*	data		I/P	The data for the command.
+*
+*	Returns:
+*	int			0 if the command was sent, 1 if s is stopped.
+*
+*******************************************************************************/
+int scenario_command(Scenario_ts* s, target_CmdType_te cmd, uint8_t data) {
+	return s->engine->send(s->target, cmd, data, s->stop);
+}
+
+/*******************************************************************************
+*	int scenario_setSpeed(Scenario_ts* s, uint8_t spd)
+*
+*	Description: Sends an ABSSPD command to the target of s; the command path
+*		records spd as its current speed.  Scenarios waiting on the speed are
+*		then notified.
+*
+*	Parameters:
+*
+*	s			I/P	The scenario setting the speed.
+*	spd			I/P	The speed to set.
+*
+*	Returns:
+*	int			0 if the speed was set, 1 if s is stopped.
+*
+*******************************************************************************/
+int scenario_setSpeed(Scenario_ts* s, uint8_t spd) {
+	if(scenario_command(s, TRAIN_ABSSPD, spd) != 0)
+		return 1;
+
+	scenario_notify(s->engine);
+	return 0;
+}
+
+/*******************************************************************************
+*	int scenario_reverse(Scenario_ts* s)
+*
+*	Description: Reverses the target of s through the command path of its
+*		engine, which sends a TOGGLE command, stopping the target, followed by
+*		an ABSSPD command restoring its current speed.  Nothing is sent if s is
+*		stopped.
+*
+*	Parameters:
+*
+*	s			I/P	The scenario reversing its target.
+*
+*	Returns:
+*	int			0 if the target was reversed, 1 if s is stopped.
+*
+*******************************************************************************/
+int scenario_reverse(Scenario_ts* s) {
+	return s->engine->reverse(s->target, s->stop);
+}
+
+/*******************************************************************************
+*	DWORD WINAPI executorThread(void* arg)
+*
+*	Description:	Runs the scenarios of the engine passed as the argument until
+*					the engine is closed.
+*
+*		Each pass resumes every sleeping scenario whose wake time has passed
+*		and, if scenario_notify was called, every waiting scenario.  Routines
+*		run without the engine lock held so they may call back into the
+*		engine.  Once a routine suspends it is queued according to what it
+*		returned.  The thread then sleeps on the wake event until the earliest
+*		wake time or until it is signalled.
+*
+*	Parameters:
+*	arg		The Scenario_Engine_ts to run.
+*
+*******************************************************************************/
+static DWORD WINAPI executorThread(void* arg) {
+	Scenario_Engine_ts* engine = arg;
+
+	while(engine->run) {
+		Scenario_ts* due = NULL;
+		Scenario_ts* s;
+		DWORD now = GetTickCount();
+		DWORD timeout = INFINITE;
+
+		/* Collect the scenarios to resume */
+		EnterCriticalSection(&engine->lock);
+		while(engine->nTimers > 0 && !BEFORE(now, engine->timers[0]->wake)) {
+			s = timerPop(engine);
+			s->next = due;
+			due = s;
+		}
+
+		if(InterlockedExchange(&engine->notified, 0)) {
+			while(engine->waiting != NULL) {
+				s = engine->waiting;
+				engine->waiting = s->next;
+				s->next = due;
+				due = s;
+			}
+		}
+		LeaveCriticalSection(&engine->lock);
+
+		/* Resume them and queue them again by what they are waiting for */
+		while(due != NULL && engine->run) {
+			s = due;
+			due = s->next;
+
+			scenario_State_te state = s->fn(s);
+
+			EnterCriticalSection(&engine->lock);
+			if(state == SCENARIO_SLEEPING) {
+				timerPush(engine, s);
+			}
+			else if(state == SCENARIO_BLOCKED) {
+				s->next = engine->waiting;
+				engine->waiting = s;
+			}
+			else {
+				s->active = 0;
+				engine->nActive--;
+			}
+			LeaveCriticalSection(&engine->lock);
+		}
+
+		/* Sleep until the earliest wake time */
+		EnterCriticalSection(&engine->lock);
+		if(engine->nTimers > 0) {
+			now = GetTickCount();
+			timeout = BEFORE(now, engine->timers[0]->wake) ?
+				engine->timers[0]->wake - now : 0;
+		}
+		LeaveCriticalSection(&engine->lock);
+
+		if(timeout > 0)
+			WaitForSingleObject(engine->wakeEvent, timeout);
+	}
+
+	return 0;
+}
+
+/*******************************************************************************
+*	void timerPush(Scenario_Engine_ts* engine, Scenario_ts* s)
+*
+*	Description:	Adds s to the heap of sleeping scenarios of the engine.  The
+*					engine lock must be held.  The heap cannot overflow since
+*					only started scenarios are ever in it.
+*
+*******************************************************************************/
+static void timerPush(Scenario_Engine_ts* engine, Scenario_ts* s) {
+	int i = engine->nTimers++;
+
+	while(i > 0) {
+		int parent = (i - 1) / 2;
+		if(!BEFORE(s->wake, engine->timers[parent]->wake)) break;
+		engine->timers[i] = engine->timers[parent];
+		i = parent;
+	}
+
+	engine->timers[i] = s;
+}
+
+/*******************************************************************************
+*	Scenario_ts* timerPop(Scenario_Engine_ts* engine)
+*
+*	Description:	Removes and returns the sleeping scenario with the earliest
+*					wake time.  The engine lock must be held and the heap must
+*					not be empty.
+*
+*******************************************************************************/
+static Scenario_ts* timerPop(Scenario_Engine_ts* engine) {
+	Scenario_ts* top = engine->timers[0];
+	Scenario_ts* last = engine->timers[--engine->nTimers];
+	int n = engine->nTimers;
+	int i = 0;
+
+	while(2 * i + 1 < n) {
+		int child = 2 * i + 1;
+		if(child + 1 < n &&
+				BEFORE(engine->timers[child + 1]->wake, engine->timers[child]->wake))
+			child++;
+		if(!BEFORE(engine->timers[child]->wake, last->wake)) break;
+		engine->timers[i] = engine->timers[child];
+		i = child;
+	}
+
+	if(n > 0)
+		engine->timers[i] = last;
+	return top;
+}
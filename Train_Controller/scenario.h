@@ -0,0 +1,308 @@
+/*******************************************************************************
+*	scenario.h
+*	Author: Joshua Newhouse
+*
+*	Tab width: 4
+*
+*	Purpose:
+*
+*	This module defines a scenario engine which runs many train routines, such
+*	as sounding the horn or shuttling back and forth, on a single executor
+*	thread instead of one thread per routine.
+*
+*	A scenario is a function written between SCENARIO_BEGIN and SCENARIO_END
+*	which may suspend itself with SCENARIO_SLEEP, to wait for a time, or with
+*	SCENARIO_AWAIT, to wait for a condition that is re-checked every time
+*	scenario_notify is called.  When resumed the function continues after the
+*	point it suspended at.  Scenarios are stackless: local variables do not
+*	survive a suspension, so any state that must is kept in the Scenario_ts.
+*	SCENARIO_SLEEP and SCENARIO_AWAIT may not be used inside a switch, nor
+*	more than once on the same line.
+*
+*	Data Types:
+*
+*	scenario_State_te	enumeration returned by a scenario when it suspends.
+*	Scenario_ts			structure used to model a single running scenario.
+*	Scenario_Engine_ts	structure used to model the executor of scenarios.
+*
+*	Procedures:
+*
+*	scenario_init		Initializes a Scenario_Engine_ts.
+*	scenario_close		Stops a Scenario_Engine_ts.
+*	scenario_start		Starts a Scenario_ts on a Scenario_Engine_ts.
+*	scenario_notify		Wakes scenarios waiting for a state change.
+*	scenario_command	Sends a command to the target of a Scenario_ts.
+*	scenario_setSpeed	Sets the speed of the target of a Scenario_ts.
+*	scenario_reverse	Reverses the target of a Scenario_ts at the same speed.
+*******************************************************************************/
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <windows.h>
+#include <stdint.h>
+
+#include "target.h"
+
+typedef enum {
+	SCENARIO_DONE,
+	SCENARIO_SLEEPING,
+	SCENARIO_BLOCKED
+} scenario_State_te;
+
+struct Scenario_s;
+struct Scenario_Engine_s;
+
+/* A scenario routine, resumed each time the scenario is woken */
+typedef scenario_State_te (*scenario_Fn)(struct Scenario_s*);
+
+/* Sends a command to a target on behalf of a scenario, unless the stop flag
+	of the scenario is set, and returns 1 if it was not sent.  The flag must
+	be checked with the command path locked.  It must also record the
+	resulting speed of the target in its attribute. */
+typedef int (*scenario_CmdFn)(Target_ts*, target_CmdType_te, uint8_t,
+	volatile LONG*);
+
+/* Reverses a target on behalf of a scenario, keeping its speed, as for
+	scenario_CmdFn.  No other command may be sent to the target in between. */
+typedef int (*scenario_RevFn)(Target_ts*, volatile LONG*);
+
+/**
+* Scenario_ts:
+*	Fields:
+*		scenario_Fn		The routine of this scenario.
+*
+*		Scenario_Engine_ts*	The engine this scenario runs on.
+*
+*		Target_ts*		The target this scenario controls.  Its attribute must
+*						point to the uint8_t current speed of the target.
+*
+*		void*			A pointer to any data used by the routine.
+*
+*		LONG*			A flag set to stop the commands of this scenario, or
+*						NULL if it is never stopped.
+*
+*		int				A counter free for use by the routine, such as for
+*						loops that span a suspension.
+*
+*		DWORD			Tick count at which a sleeping scenario is resumed.
+*
+*		uint16_t		The point to resume the routine at, 0 to start it.
+*
+*		uint8_t			1 while the scenario is started, 0 otherwise.
+*
+*		Scenario_ts*	The next scenario waiting for a state change.
+*/
+typedef struct Scenario_s {
+	scenario_Fn fn;
+	struct Scenario_Engine_s* engine;
+	Target_ts* target;
+	void* ctx;
+	volatile LONG* stop;
+	int count;
+	DWORD wake;
+	uint16_t line;
+	uint8_t active;
+	struct Scenario_s* next;
+} Scenario_ts;
+
+/**
+* Scenario_Engine_ts:
+*	Fields:
+*		Scenario_ts**	Heap of sleeping scenarios ordered by wake time.
+*
+*		int				Number of scenarios in the heap.
+*
+*		int				Number of scenarios started and the maximum allowed,
+*						which is also the capacity of the heap.
+*
+*		Scenario_ts*	List of scenarios waiting for a state change.
+*
+*		LONG			1 if scenario_notify was called since the waiting
+*						scenarios were last resumed.
+*
+*		LONG			1 while the executor should keep running.
+*
+*		scenario_CmdFn	The command path scenarios send commands through.
+*
+*		scenario_RevFn	The command path scenarios reverse targets through.
+*
+*		CRITICAL_SECTION	Lock for the heap and the waiting list.
+*
+*		HANDLE			Event used to wake the executor thread.
+*
+*		HANDLE			The executor thread.
+*/
+typedef struct Scenario_Engine_s {
+	Scenario_ts** timers;
+	int nTimers;
+	int nActive;
+	int capacity;
+	Scenario_ts* waiting;
+	volatile LONG notified;
+	volatile LONG run;
+	scenario_CmdFn send;
+	scenario_RevFn reverse;
+	CRITICAL_SECTION lock;
+	HANDLE wakeEvent;
+	HANDLE thread;
+} Scenario_Engine_ts;
+
+/* Marks the start of a scenario routine */
+#define SCENARIO_BEGIN(s)	switch((s)->line) { case 0:
+
+/* Marks the end of a scenario routine; the scenario is then done */
+#define SCENARIO_END(s)		} (s)->line = 0; return SCENARIO_DONE
+
+/* Suspends the scenario for ms milliseconds */
+#define SCENARIO_SLEEP(s, ms)											\
+	do {																\
+		(s)->line = __LINE__;											\
+		(s)->wake = GetTickCount() + (ms);								\
+		return SCENARIO_SLEEPING;										\
+		case __LINE__:;													\
+	} while(0)
+
+/* Suspends the scenario until cond holds after a call to scenario_notify */
+#define SCENARIO_AWAIT(s, cond)											\
+	do {																\
+		(s)->line = __LINE__;											\
+		case __LINE__:													\
+		if(!(cond)) return SCENARIO_BLOCKED;							\
+	} while(0)
+
+/*******************************************************************************
+*	scenario_init
+*
+*	Description: Initializes a scenario engine and starts its executor thread.
+*
+*	Parameters:
+*
+*	Scenario_Engine_ts*	A pointer to the engine to initialize.
+*
+*	int					The maximum number of scenarios started at once.
+*
+*	scenario_CmdFn		The command path scenarios send commands through.  It
+*						is called on the executor thread.
+*
+*	scenario_RevFn		The command path scenarios reverse targets through.  It
+*						is called on the executor thread.
+*
+*	Returns:
+*
+*	int			0 if the engine was initialized successfully, 1 otherwise.
+*******************************************************************************/
+int scenario_init(Scenario_Engine_ts*, int, scenario_CmdFn, scenario_RevFn);
+
+/*******************************************************************************
+*	scenario_close
+*
+*	Description:	Stops the executor thread and releases the engine.  Any
+*					scenarios still started are abandoned.
+*
+*	Parameters:
+*
+*	Scenario_Engine_ts*	The engine to close.
+*
+*******************************************************************************/
+void scenario_close(Scenario_Engine_ts*);
+
+/*******************************************************************************
+*	scenario_start
+*
+*	Description:	Starts a scenario on the engine.  The routine is first run
+*					on the executor thread as soon as possible.
+*
+*	Parameters:
+*
+*	Scenario_Engine_ts*	The engine to run the scenario on.
+*
+*	Scenario_ts*	The scenario to start.  It must be zero initialized before
+*					it is first started and remain valid until the routine is
+*					done or the engine is closed.
+*
+*	scenario_Fn		The routine of the scenario.
+*
+*	Target_ts*		The target the scenario controls.
+*
+*	void*			A pointer to any data used by the routine.
+*
+*	LONG*			A flag which, once set, stops every command the scenario
+*					sends, or NULL.  It is only read by the engine.
+*
+*	Returns:
+*
+*	int			0 if the scenario was started, 1 if it is already started or
+*				the engine is full.
+*******************************************************************************/
+int scenario_start(Scenario_Engine_ts*, Scenario_ts*, scenario_Fn, Target_ts*,
+	void*, volatile LONG*);
+
+/*******************************************************************************
+*	scenario_notify
+*
+*	Description:	Signals that the state scenarios may be waiting for has
+*					changed so that their SCENARIO_AWAIT conditions are checked.
+*
+*	Parameters:
+*
+*	Scenario_Engine_ts*	The engine whose scenarios to wake.
+*
+*******************************************************************************/
+void scenario_notify(Scenario_Engine_ts*);
+
+/*******************************************************************************
+*	scenario_command
+*
+*	Description:	Sends a command to the target of the scenario through the
+*					command path of its engine.
+*
+*	Parameters:
+*
+*	Scenario_ts*		The scenario sending the command.
+*
+*	target_CmdType_te	The command to send.
+*
+*	uint8_t				The data for the command, as for target_setCommand.
+*
+*	Returns:
+*
+*	int			0 if the command was sent, 1 if the scenario is stopped.
+*******************************************************************************/
+int scenario_command(Scenario_ts*, target_CmdType_te, uint8_t);
+
+/*******************************************************************************
+*	scenario_setSpeed
+*
+*	Description:	Sets the absolute speed of the target of the scenario and
+*					wakes the scenarios waiting on it.
+*
+*	Parameters:
+*
+*	Scenario_ts*	The scenario setting the speed.
+*
+*	uint8_t			The speed to set.
+*
+*	Returns:
+*
+*	int			0 if the speed was set, 1 if the scenario is stopped.
+*******************************************************************************/
+int scenario_setSpeed(Scenario_ts*, uint8_t);
+
+/*******************************************************************************
+*	scenario_reverse
+*
+*	Description:	Toggles the direction of the target of the scenario and
+*					then restores its current speed, as one step of the
+*					command path.
+*
+*	Parameters:
+*
+*	Scenario_ts*	The scenario reversing its target.
+*
+*	Returns:
+*
+*	int			0 if the target was reversed, 1 if the scenario is stopped.
+*******************************************************************************/
+int scenario_reverse(Scenario_ts*);
+
+#endif
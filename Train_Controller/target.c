@@ -13,6 +13,8 @@
 *	target_init			initializes a Target_ts.
 *	target_setCommand	sets the command field of the target.
 *	target_getCommand	returns the command field from the target.
+*	target_decode		decodes a 3 byte command back into its fields.
+*	target_applySpeed	returns the speed of a train after a command.
 *******************************************************************************/
 #include <stdint.h>
 
@@ -100,3 +102,105 @@ void target_setCommand(Target_ts* target, target_CmdType_te cmd, uint8_t spd) {
 int8_t* target_getCommand(Target_ts* target) {
 	return target->bytes;
 }
+
+/*******************************************************************************
+*	int target_decode(const int8_t bytes[], uint8_t* adr, target_CmdType_te* cmd,
+*		uint8_t* data)
+*
+*	Description:	Decodes a 3 byte command back into the target address, the
+*					command and its data.  This is the inverse of target_init
+*					followed by target_setCommand.
+*
+*		The command bytes are laid out as follows:
+*			11111110 - 00AAAAAA - ACCDDDDD
+*
+*		A SYSTEM_HALT command sets every bit of the second and third bytes.
+*		Otherwise when the two C bits are 11 the command is ABSSPD and when
+*		they are 10 it is RELSPD, in both cases with the D bits as the speed.
+*		Any other value of the 7 LSB of the third byte is the command itself.
+*
+*	Parameters:
+*
+*	bytes	I/P	The 3 byte command to decode.
+*	adr		O/P	The address of the target.
+*	cmd		O/P	The command.
+*	data	O/P	The command data for ABSSPD and RELSPD, 0 otherwise.
+*
+*	Returns:
+*	int			0 if the bytes form a valid command, 1 otherwise.
+*				Failure may occur due to a missing 0xFE lead byte, a set bit in
+*				the 2 MSB of the second byte or an unknown command.
+*******************************************************************************/
+int target_decode(const int8_t bytes[], uint8_t* adr, target_CmdType_te* cmd,
+		uint8_t* data) {
+	uint8_t b1 = (uint8_t)bytes[1];
+	uint8_t b2 = (uint8_t)bytes[2];
+	uint8_t c = b2 & ~CLEAR;
+
+	if((uint8_t)bytes[0] != 0xFE) return 1;
+
+	*data = 0;
+	if(b1 == SYSTEM_HALT && b2 == SYSTEM_HALT) {
+		*adr = 0;
+		*cmd = SYSTEM_HALT;
+		return 0;
+	}
+
+	if(b1 & 0xC0) return 1;
+	*adr = (uint8_t)(b1 << 1 | b2 >> 7);
+
+	if((c & TRAIN_ABSSPD) == TRAIN_ABSSPD) {
+		*cmd = TRAIN_ABSSPD;
+		*data = c & 0x1F;
+	}
+	else if((c & TRAIN_ABSSPD) == TRAIN_RELSPD) {
+		*cmd = TRAIN_RELSPD;
+		*data = c & 0x1F;
+	}
+	else {
+		switch(c) {
+		case TRAIN_BOOST: case TRAIN_BRAKE: case TRAIN_FORWARD:
+		case TRAIN_HORN1: case TRAIN_HORN2: case TRAIN_REVERSE:
+		case TRAIN_TOGGLE:
+			*cmd = (target_CmdType_te)c;
+			break;
+		default:
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*******************************************************************************
+*	uint8_t target_applySpeed(target_CmdType_te cmd, uint8_t data, uint8_t spd)
+*
+*	Description:	Returns the speed a train has after receiving the command
+*					cmd with data, given its speed before was spd.
+*
+*		ABSSPD sets the speed to data.  RELSPD changes the speed by data less
+*		5, so 6 speeds the train up by 1, 4 slows it down by 1 and 5 leaves it
+*		unchanged; the result is kept within [0,1F].  TOGGLE stops the train.
+*		Any other command leaves the speed unchanged.
+*
+*	Parameters:
+*
+*	cmd		I/P	The command sent to the train.
+*	data	I/P	The command data.
+*	spd		I/P	The speed of the train before the command.
+*
+*	Returns:
+*	uint8_t		The speed of the train after the command.
+*******************************************************************************/
+uint8_t target_applySpeed(target_CmdType_te cmd, uint8_t data, uint8_t spd) {
+	int s = spd;
+
+	if(cmd == TRAIN_ABSSPD)
+		s = data;
+	else if(cmd == TRAIN_RELSPD)
+		s += data - 5;
+	else if(cmd == TRAIN_TOGGLE)
+		s = 0;
+
+	return s < 0 ? 0 : s > 0x1F ? 0x1F : (uint8_t)s;
+}
@@ -24,6 +24,8 @@
 *	target_init			initializes a Target_ts.
 *	target_setCommand	sets the command field of the target.
 *	target_getCommand	returns the command field from the target.
+*	target_decode		decodes a 3 byte command back into its fields.
+*	target_applySpeed	returns the speed of a train after a command.
 *******************************************************************************/
 #ifndef TARGET_H
 #define TARGET_H
@@ -119,4 +121,50 @@ void target_setCommand(Target_ts*, target_CmdType_te, uint8_t);
 *******************************************************************************/
 int8_t* target_getCommand(Target_ts*);
 
+/*******************************************************************************
+*	target_decode
+*
+*	Description:	Decodes a 3 byte command, as built by target_init and
+*					target_setCommand, back into the target address, the
+*					command and its data.
+*
+*	Parameters:
+*
+*	const int8_t[3]		The 3 byte command to decode.
+*
+*	uint8_t*			Receives the address of the target.
+*
+*	target_CmdType_te*	Receives the command.
+*
+*	uint8_t*			Receives the command data; only meaningful for ABSSPD
+*						and RELSPD commands, 0 otherwise.
+*
+*	Returns:
+*
+*	int					0 if the bytes form a valid command, 1 otherwise.
+*******************************************************************************/
+int target_decode(const int8_t[], uint8_t*, target_CmdType_te*, uint8_t*);
+
+/*******************************************************************************
+*	target_applySpeed
+*
+*	Description:	Returns the speed a train has after receiving a command,
+*					given its speed before.  Used to follow the speed of a
+*					train from the commands sent to it.
+*
+*	Parameters:
+*
+*	target_CmdType_te	The command, as returned by target_decode.
+*
+*	uint8_t				The command data, as returned by target_decode.
+*
+*	uint8_t				The speed of the train before the command.
+*
+*	Returns:
+*
+*	uint8_t				The speed of the train after the command, in the range
+*						[0,1F].
+*******************************************************************************/
+uint8_t target_applySpeed(target_CmdType_te, uint8_t, uint8_t);
+
 #endif
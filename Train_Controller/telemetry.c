@@ -0,0 +1,381 @@
+/*******************************************************************************
+*	telemetry.c
+*	Author: Joshua Newhouse
+*
+*	Tab width: 4
+*
+*	Purpose:
+*
+*	This implements the telemetry.h interface.
+*
+*	Procedures:
+*
+*	telemetry_open		Creates a Telemetry_ts for publishing.
+*	telemetry_attach	Opens an existing Telemetry_ts for reading.
+*	telemetry_close		Closes a Telemetry_ts.
+*	telemetry_publish	Publishes a command sent to a target.
+*	telemetry_pending	Adjusts the number of commands waiting to be sent.
+*	telemetry_snapshot	Copies a consistent view of the Telemetry_ts.
+*	seqBegin			Marks a record as being written.
+*	seqEnd				Marks a record as written.
+*	seqRead				Copies a record written with seqBegin and seqEnd.
+*******************************************************************************/
+#include <windows.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+static void seqBegin(volatile LONG*);
+static void seqEnd(volatile LONG*);
+static void seqRead(volatile LONG*, void*, const volatile void*, size_t);
+
+/*******************************************************************************
+*	int telemetry_open(Telemetry_ts* tel, char* name)
+*
+*	Description: Creates the shared memory page called name, backed by the
+*		paging file, and fills in its header.  Every target record starts
+*		inactive.
+*
+*		Only one controller may publish to the page, which is checked with a
+*		named mutex that lives as long as the controller holding it.  The page
+*		itself may still exist, left by an earlier run and held open by a
+*		reader.  It is then reset under the sequence counters, which are never
+*		zeroed, so that the reader sees the new run consistently.
+*
+*	Parameters:
+*
+*	tel			I/O	A pointer to the telemetry object to open.
+*	name		I/P	The name of the shared memory page.
+*
+*	Returns:
+*	int			0 if the page was created successfully, 1 otherwise.
+*				Failure may occur due to:
+*					another controller publishing to the page,
+*					not being able to create the page,
+*					not being able to map the page,
+*					an existing page having a different version or size.
+*******************************************************************************/
+int telemetry_open(Telemetry_ts* tel, char* name) {
+	char writer[MAX_PATH];
+	int existed, a;
+
+	if(tel == NULL) return 1;
+
+	tel->page = NULL;
+	tel->hMap = NULL;
+	snprintf(writer, sizeof(writer), "%s" TELEMETRY_WRITER_SUFFIX, name);
+	tel->hWriter = CreateMutex(NULL, FALSE, writer);
+	if(tel->hWriter == NULL) {
+		fprintf(stderr, "Error creating telemetry writer lock\n");
+		return 1;
+	}
+	if(GetLastError() == ERROR_ALREADY_EXISTS) {
+		fprintf(stderr, "Error telemetry page is published by another "
+			"controller\n");
+		telemetry_close(tel);
+		return 1;
+	}
+
+	tel->hMap = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		0, sizeof(Telemetry_Page_ts), name);
+	if(tel->hMap == NULL) {
+		fprintf(stderr, "Error creating telemetry page\n");
+		telemetry_close(tel);
+		return 1;
+	}
+	existed = GetLastError() == ERROR_ALREADY_EXISTS;
+
+	tel->page = MapViewOfFile(tel->hMap, FILE_MAP_WRITE, 0, 0,
+		sizeof(Telemetry_Page_ts));
+	if(tel->page == NULL) {
+		fprintf(stderr, "Error mapping telemetry page\n");
+		telemetry_close(tel);
+		return 1;
+	}
+
+	Telemetry_Page_ts* p = tel->page;
+	if(existed && p->magic == TELEMETRY_MAGIC &&
+			(p->version != TELEMETRY_VERSION ||
+			p->size != sizeof(Telemetry_Page_ts))) {
+		fprintf(stderr, "Error telemetry page version %u is in use\n",
+			(unsigned)p->version);
+		telemetry_close(tel);
+		return 1;
+	}
+
+	/* A new page is already zero filled */
+	if(existed) {
+		for(a = 0; a < TELEMETRY_MAX_TARGETS; a++) {
+			seqBegin(&p->trains[a].seq);
+			memset((char*)&p->trains[a] + offsetof(Telemetry_Train_ts, active),
+				0, sizeof(Telemetry_Train_ts) -
+				offsetof(Telemetry_Train_ts, active));
+			seqEnd(&p->trains[a].seq);
+		}
+		InterlockedExchange(&p->pending, 0);
+	}
+
+	seqBegin(&p->seq);
+	p->startTick = GetTickCount();
+	p->tick = p->startTick;
+	p->halted = 0;
+	p->frames = 0;
+	p->errors = 0;
+	seqEnd(&p->seq);
+
+	p->version = TELEMETRY_VERSION;
+	p->maxTargets = TELEMETRY_MAX_TARGETS;
+	p->size = sizeof(Telemetry_Page_ts);
+
+	/* Readers check the magic last, once the header is complete */
+	MemoryBarrier();
+	p->magic = TELEMETRY_MAGIC;
+
+	return 0;
+}
+
+/*******************************************************************************
+*	int telemetry_attach(Telemetry_ts* tel, char* name)
+*
+*	Description: Opens the existing shared memory page called name read only
+*		and checks that its layout matches this version of the module.
+*
+*	Parameters:
+*
+*	tel			I/O	A pointer to the telemetry object to attach.
+*	name		I/P	The name of the shared memory page.
+*
+*	Returns:
+*	int			0 if the page was opened successfully, 1 otherwise.
+*				Failure may occur due to:
+*					no controller having created the page,
+*					not being able to map the page,
+*					the page having a different magic, version or size.
+*******************************************************************************/
+int telemetry_attach(Telemetry_ts* tel, char* name) {
+	if(tel == NULL) return 1;
+
+	tel->page = NULL;
+	tel->hWriter = NULL;
+	tel->hMap = OpenFileMapping(FILE_MAP_READ, FALSE, name);
+	if(tel->hMap == NULL) {
+		fprintf(stderr, "Error opening telemetry page; is the controller "
+			"running?\n");
+		return 1;
+	}
+
+	tel->page = MapViewOfFile(tel->hMap, FILE_MAP_READ, 0, 0,
+		sizeof(Telemetry_Page_ts));
+	if(tel->page == NULL) {
+		fprintf(stderr, "Error mapping telemetry page\n");
+		CloseHandle(tel->hMap);
+		tel->hMap = NULL;
+		return 1;
+	}
+
+	if(tel->page->magic != TELEMETRY_MAGIC ||
+			tel->page->version != TELEMETRY_VERSION ||
+			tel->page->size != sizeof(Telemetry_Page_ts)) {
+		fprintf(stderr, "Error telemetry page version %u not supported\n",
+			(unsigned)tel->page->version);
+		telemetry_close(tel);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*******************************************************************************
+*	void telemetry_close(Telemetry_ts* tel)
+*
+*	Description: Unmaps the page and closes its handles.  The page itself is
+*		removed once no process has it open.
+*
+*	Parameters:
+*
+*	tel			I/O	A pointer to the telemetry object to close.
+*
+*******************************************************************************/
+void telemetry_close(Telemetry_ts* tel) {
+	if(tel->page != NULL)
+		UnmapViewOfFile(tel->page);
+	if(tel->hMap != NULL)
+		CloseHandle(tel->hMap);
+	if(tel->hWriter != NULL)
+		CloseHandle(tel->hWriter);
+
+	tel->page = NULL;
+	tel->hMap = NULL;
+	tel->hWriter = NULL;
+}
+
+/*******************************************************************************
+*	void telemetry_publish(Telemetry_ts* tel, Target_ts* target, int err)
+*
+*	Description:	Publishes the command currently set on target, which has
+*					just been sent to the base with the result err.
+*
+*		The command is decoded with target_decode to update the state of the
+*		target it was sent to:
+*			the speed follows target_applySpeed,
+*			FORWARD and REVERSE set the direction,
+*			TOGGLE flips the direction,
+*			SYSTEM_HALT marks the page as halted.
+*
+*		Only plain stores and memory barriers are used, so this adds no system
+*		call or lock to the command path.  Calls must be serialized, which the
+*		command path already does.
+*
+*	Parameters:
+*
+*	tel			I/O	A pointer to the telemetry object to publish to.
+*	target		I/P	The target the command was sent to.
+*	err			I/P	0 if the command was sent, 1 otherwise.
+*
+*******************************************************************************/
+void telemetry_publish(Telemetry_ts* tel, Target_ts* target, int err) {
+	Telemetry_Page_ts* p = tel->page;
+	uint8_t adr, data;
+	target_CmdType_te cmd;
+	DWORD now;
+	int valid;
+
+	if(p == NULL) return;
+
+	now = GetTickCount();
+	valid = target_decode(target_getCommand(target), &adr, &cmd, &data) == 0;
+
+	seqBegin(&p->seq);
+	p->tick = now;
+	p->frames++;
+	p->errors += err != 0;
+	if(valid && cmd == SYSTEM_HALT)
+		p->halted = 1;
+	seqEnd(&p->seq);
+
+	if(!valid || cmd == SYSTEM_HALT) return;
+
+	Telemetry_Train_ts* t = &p->trains[adr];
+	seqBegin(&t->seq);
+	t->active = 1;
+	t->address = adr;
+	t->lastTick = now;
+	t->frames++;
+	t->errors += err != 0;
+	t->speed = target_applySpeed(cmd, data, t->speed);
+
+	switch(cmd) {
+	case TRAIN_FORWARD:
+		t->direction = 1;
+		break;
+	case TRAIN_REVERSE:
+		t->direction = -1;
+		break;
+	case TRAIN_TOGGLE:
+		t->direction = -t->direction;
+		break;
+	default:
+		break;
+	}
+	seqEnd(&t->seq);
+}
+
+/*******************************************************************************
+*	void telemetry_pending(Telemetry_ts* tel, LONG delta)
+*
+*	Description:	Atomically adds delta to the number of commands waiting
+*					for the command path.
+*
+*	Parameters:
+*
+*	tel			I/O	A pointer to the telemetry object to publish to.
+*	delta		I/P	1 when a command starts waiting, -1 when it stops.
+*
+*******************************************************************************/
+void telemetry_pending(Telemetry_ts* tel, LONG delta) {
+	if(tel->page != NULL)
+		InterlockedExchangeAdd(&tel->page->pending, delta);
+}
+
+/*******************************************************************************
+*	void telemetry_snapshot(Telemetry_ts* tel, Telemetry_Page_ts* out)
+*
+*	Description:	Copies the header and every target record of the page into
+*					out, each with seqRead.
+*
+*	Parameters:
+*
+*	tel			I/P	A pointer to the attached telemetry object.
+*	out			O/P	Receives the copy.
+*
+*******************************************************************************/
+void telemetry_snapshot(Telemetry_ts* tel, Telemetry_Page_ts* out) {
+	Telemetry_Page_ts* p = tel->page;
+	int a;
+
+	out->magic = p->magic;
+	out->version = p->version;
+	out->maxTargets = p->maxTargets;
+	out->size = p->size;
+	out->pending = p->pending;
+
+	/* The header fields guarded by seq follow it up to the records */
+	seqRead(&p->seq, &out->startTick, &p->startTick,
+		offsetof(Telemetry_Page_ts, trains) -
+		offsetof(Telemetry_Page_ts, startTick));
+	out->seq = 0;
+
+	for(a = 0; a < TELEMETRY_MAX_TARGETS; a++) {
+		seqRead(&p->trains[a].seq, &out->trains[a], &p->trains[a],
+			sizeof(Telemetry_Train_ts));
+		out->trains[a].seq = 0;
+	}
+}
+
+/*******************************************************************************
+*	void seqBegin(volatile LONG* seq)
+*
+*	Description:	Makes seq odd before a record is written.  The barrier keeps
+*					the writes to the record after the counter.
+*
+*******************************************************************************/
+static void seqBegin(volatile LONG* seq) {
+	*seq = *seq + 1;
+	MemoryBarrier();
+}
+
+/*******************************************************************************
+*	void seqEnd(volatile LONG* seq)
+*
+*	Description:	Makes seq even after a record is written.  The barrier keeps
+*					the writes to the record before the counter.
+*
+*******************************************************************************/
+static void seqEnd(volatile LONG* seq) {
+	MemoryBarrier();
+	*seq = *seq + 1;
+}
+
+/*******************************************************************************
+*	void seqRead(volatile LONG* seq, void* dst, const volatile void* src,
+*		size_t n)
+*
+*	Description:	Copies n bytes of the record guarded by seq from src to dst,
+*					retrying until the copy was not overlapped by a write.
+*
+*******************************************************************************/
+static void seqRead(volatile LONG* seq, void* dst, const volatile void* src,
+		size_t n) {
+	LONG before, after;
+
+	do {
+		while((before = *seq) & 1)
+			YieldProcessor();
+		MemoryBarrier();
+		memcpy(dst, (const void*)src, n);
+		MemoryBarrier();
+		after = *seq;
+	} while(before != after);
+}
@@ -0,0 +1,232 @@
+/*******************************************************************************
+*	telemetry.h
+*	Author: Joshua Newhouse
+*
+*	Tab width: 4
+*
+*	Purpose:
+*
+*	This module defines a telemetry class which publishes the live state of
+*	the targets in the train-set system into a named shared memory page, so
+*	that external monitors can watch it while the controller runs.
+*
+*	The controller is the only writer.  Every record in the page is guarded by
+*	a sequence counter which is odd while the record is being written, so
+*	publishing takes no lock and makes no system call.  Readers copy a record
+*	and retry if the counter was odd or changed during the copy.
+*
+*	Data Types:
+*
+*	Telemetry_Train_ts	structure used to publish the state of a target.
+*	Telemetry_Page_ts	structure laid out in the shared memory page.
+*	Telemetry_ts		structure used to model an open telemetry page.
+*
+*	Procedures:
+*
+*	telemetry_open		Creates a Telemetry_ts for publishing.
+*	telemetry_attach	Opens an existing Telemetry_ts for reading.
+*	telemetry_close		Closes a Telemetry_ts.
+*	telemetry_publish	Publishes a command sent to a target.
+*	telemetry_pending	Adjusts the number of commands waiting to be sent.
+*	telemetry_snapshot	Copies a consistent view of the Telemetry_ts.
+*******************************************************************************/
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <windows.h>
+#include <stdint.h>
+
+#include "target.h"
+
+/* Name of the shared memory page and the layout version published in it.
+	The version must be changed whenever Telemetry_Page_ts is. */
+#define TELEMETRY_NAME "Local\\TrainTelemetry"
+#define TELEMETRY_MAGIC 0x544E5254		/* "TRNT" */
+#define TELEMETRY_VERSION 1
+
+/* Appended to the page name to name the mutex held by its only writer */
+#define TELEMETRY_WRITER_SUFFIX "Writer"
+
+/* Number of addresses a target can have */
+#define TELEMETRY_MAX_TARGETS 128
+
+/**
+* Telemetry_Train_ts:
+*	Fields:
+*		LONG		Sequence counter, odd while the record is being written.
+*
+*		uint8_t		1 once a command has been sent to this target, 0 otherwise.
+*
+*		uint8_t		The address of the target.
+*
+*		uint8_t		The speed last commanded.
+*
+*		int8_t		The direction last commanded; 1 forward, -1 reverse, 0 if
+*					not yet known.
+*
+*		uint32_t	Tick count when the last command was sent.
+*
+*		uint64_t	Number of commands sent and of those that failed.
+*/
+typedef struct {
+	volatile LONG seq;
+	uint8_t active;
+	uint8_t address;
+	uint8_t speed;
+	int8_t direction;
+	uint32_t lastTick;
+	uint64_t frames;
+	uint64_t errors;
+} Telemetry_Train_ts;
+
+/**
+* Telemetry_Page_ts:
+*	Fields:
+*		uint32_t	TELEMETRY_MAGIC, set once when the page is created.
+*
+*		uint16_t	TELEMETRY_VERSION, set once when the page is created.
+*
+*		uint16_t	Number of target records, TELEMETRY_MAX_TARGETS.
+*
+*		uint32_t	Size of the page in bytes.
+*
+*		LONG		Number of commands waiting for the command path.  Updated
+*					atomically and not guarded by seq.
+*
+*		LONG		Sequence counter for the remaining fields of the header.
+*
+*		uint32_t	Tick counts when the page was created and last updated.
+*
+*		uint32_t	1 once SYSTEM_HALT has been sent, 0 otherwise.
+*
+*		uint64_t	Number of commands sent to all targets and of those that
+*					failed.
+*
+*		Telemetry_Train_ts[]	The state of each target address.
+*/
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t maxTargets;
+	uint32_t size;
+	volatile LONG pending;
+	volatile LONG seq;
+	uint32_t startTick;
+	uint32_t tick;
+	uint32_t halted;
+	uint64_t frames;
+	uint64_t errors;
+	Telemetry_Train_ts trains[TELEMETRY_MAX_TARGETS];
+} Telemetry_Page_ts;
+
+/**
+* Telemetry_ts:
+*	Fields:
+*		HANDLE		The shared memory page.
+*
+*		HANDLE		The mutex naming the writer of the page, NULL for readers.
+*
+*		Telemetry_Page_ts*	The mapped page, NULL if telemetry is disabled.
+*/
+typedef struct {
+	HANDLE hMap;
+	HANDLE hWriter;
+	Telemetry_Page_ts* page;
+} Telemetry_ts;
+
+/*******************************************************************************
+*	telemetry_open
+*
+*	Description: Creates the shared memory page for publishing.
+*
+*	Parameters:
+*
+*	Telemetry_ts*	A pointer to the telemetry object to open.
+*
+*	char*			The name of the shared memory page.
+*
+*	Returns:
+*
+*	int			0 if the page was created successfully, 1 otherwise, such as
+*				when another controller already publishes to it.  On failure
+*				the telemetry object is left disabled and may still be passed
+*				to the other procedures.
+*******************************************************************************/
+int telemetry_open(Telemetry_ts*, char*);
+
+/*******************************************************************************
+*	telemetry_attach
+*
+*	Description: Opens an existing shared memory page for reading.
+*
+*	Parameters:
+*
+*	Telemetry_ts*	A pointer to the telemetry object to attach.
+*
+*	char*			The name of the shared memory page.
+*
+*	Returns:
+*
+*	int			0 if the page was opened successfully, 1 otherwise.
+*******************************************************************************/
+int telemetry_attach(Telemetry_ts*, char*);
+
+/*******************************************************************************
+*	telemetry_close
+*
+*	Description:	Unmaps and closes the telemetry object.
+*
+*	Parameters:
+*
+*	Telemetry_ts*	The telemetry object to close.
+*
+*******************************************************************************/
+void telemetry_close(Telemetry_ts*);
+
+/*******************************************************************************
+*	telemetry_publish
+*
+*	Description:	Publishes the command currently set on a target, which has
+*					just been sent to the base.  Calls must be serialized.
+*
+*	Parameters:
+*
+*	Telemetry_ts*	The telemetry object to publish to.
+*
+*	Target_ts*		The target the command was sent to.
+*
+*	int				The result of sending the command; 0 if it was sent, 1
+*					otherwise.
+*******************************************************************************/
+void telemetry_publish(Telemetry_ts*, Target_ts*, int);
+
+/*******************************************************************************
+*	telemetry_pending
+*
+*	Description:	Adds to the number of commands waiting for the command
+*					path.  Safe to call from any thread.
+*
+*	Parameters:
+*
+*	Telemetry_ts*	The telemetry object to publish to.
+*
+*	LONG			1 when a command starts waiting, -1 when it stops.
+*******************************************************************************/
+void telemetry_pending(Telemetry_ts*, LONG);
+
+/*******************************************************************************
+*	telemetry_snapshot
+*
+*	Description:	Copies the page of an attached telemetry object.  Each
+*					record of the copy is consistent, but records may have been
+*					copied at slightly different times.
+*
+*	Parameters:
+*
+*	Telemetry_ts*		The telemetry object to copy.
+*
+*	Telemetry_Page_ts*	Receives the copy.
+*******************************************************************************/
+void telemetry_snapshot(Telemetry_ts*, Telemetry_Page_ts*);
+
+#endif
@@ -0,0 +1,118 @@
+/*******************************************************************************
+*	telemetry_viewer.c
+*	Author: Joshua Newhouse
+*
+*	Tab width: 4
+*
+*	Purpose:
+*
+*	This implements a terminal viewer for the telemetry page published by the
+*	train controller.  The state of every active target is redrawn every
+*	REFRESH_MS until a key is pressed.
+*
+*	Procedures:
+*
+*	main				contains the beginning of the code.
+*	printTelemetry		displays a snapshot of the telemetry page.
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <conio.h>
+
+#include "telemetry.h"
+
+/* Time between redraws in ms */
+#define REFRESH_MS 500
+
+/* functions declaration */
+void printTelemetry(const Telemetry_Page_ts*, const Telemetry_Page_ts*, DWORD);
+
+/* Reserve space for the current and previous snapshots; frame rates are
+	taken over the time between them. */
+static Telemetry_Page_ts snapshots[2];
+
+/* main function */
+int main(void) {
+	Telemetry_ts telemetry;
+	int cur = 0;
+
+	if(telemetry_attach(&telemetry, TELEMETRY_NAME) != 0)
+		exit(EXIT_FAILURE);
+
+	telemetry_snapshot(&telemetry, &snapshots[1]);
+	DWORD last = GetTickCount();
+
+	while(!_kbhit()) {
+		Sleep(REFRESH_MS);
+
+		DWORD now = GetTickCount();
+		telemetry_snapshot(&telemetry, &snapshots[cur]);
+		printTelemetry(&snapshots[cur], &snapshots[!cur], now - last);
+
+		last = now;
+		cur = !cur;
+	}
+
+	getch();
+	telemetry_close(&telemetry);
+	exit(EXIT_SUCCESS);
+}
+
+/*******************************************************************************
+*	void printTelemetry(const Telemetry_Page_ts* cur,
+*		const Telemetry_Page_ts* prev, DWORD elapsed)
+*
+*	Description:	Clears the screen and displays the snapshot cur.  Frame
+*					rates are the number of frames sent since the snapshot prev,
+*					taken elapsed ms earlier.  If the controller restarted in
+*					between, its start tick differs or its frame count went
+*					down, and no rates are shown for this refresh.
+*
+*	Parameters:
+*	cur		The current snapshot.
+*	prev	The previous snapshot.
+*	elapsed	The time in ms between the two snapshots.
+*
+*******************************************************************************/
+void printTelemetry(const Telemetry_Page_ts* cur, const Telemetry_Page_ts* prev,
+		DWORD elapsed) {
+	double secs = elapsed > 0 ? elapsed / 1000.0 : 1;
+	DWORD now = GetTickCount();
+	int restarted = cur->startTick != prev->startTick ||
+		cur->frames < prev->frames;
+	int a;
+
+	system("cls");
+	printf("Train Telemetry (version %u); press any key to quit\n\n",
+		(unsigned)cur->version);
+	printf("Uptime:   %lu s%s\n",
+		(unsigned long)((now - cur->startTick) / 1000),
+		cur->halted ? "  HALTED" : "");
+	if(restarted)
+		printf("Frames:   %llu (-/s)\n", (unsigned long long)cur->frames);
+	else
+		printf("Frames:   %llu (%.1f/s)\n", (unsigned long long)cur->frames,
+			(cur->frames - prev->frames) / secs);
+	printf("Errors:   %llu\n", (unsigned long long)cur->errors);
+	printf("Queue:    %ld\n\n", (long)cur->pending);
+
+	printf("%4s %5s %4s %10s %9s %8s %8s\n", "Addr", "Speed", "Dir", "Frames",
+		"Frames/s", "Errors", "Idle s");
+
+	for(a = 0; a < TELEMETRY_MAX_TARGETS; a++) {
+		const Telemetry_Train_ts* t = &cur->trains[a];
+		if(!t->active) continue;
+
+		printf("%4u %5u %4s %10llu ", (unsigned)t->address,
+			(unsigned)t->speed,
+			t->direction > 0 ? "fwd" : t->direction < 0 ? "rev" : "?",
+			(unsigned long long)t->frames);
+		if(restarted || t->frames < prev->trains[a].frames)
+			printf("%9s", "-");
+		else
+			printf("%9.1f", (t->frames - prev->trains[a].frames) / secs);
+		printf(" %8llu %8lu\n", (unsigned long long)t->errors,
+			(unsigned long)((now - t->lastTick) / 1000));
+	}
+}
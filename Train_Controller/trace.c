@@ -0,0 +1,128 @@
+/*******************************************************************************
+*	trace.c
+*	Author: Joshua Newhouse
+*
+*	Tab width: 4
+*
+*	Purpose:
+*
+*	This implements the trace.h interface.
+*
+*	Procedures:
+*
+*	trace_open			Opens a Trace_ts.
+*	trace_close			Closes a Trace_ts.
+*	trace_record		Appends a frame to the Trace_ts.
+*******************************************************************************/
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "trace.h"
+
+/*******************************************************************************
+*	int trace_open(Trace_ts* trace, char* path)
+*
+*	Description: Creates a frame log named prefix-YYYYMMDD-HHMMSS.trc after
+*		the current local time and writes its header.  The current tick count
+*		is time 0 of the log and the current wall clock time is recorded in the
+*		header as its start time.
+*
+*		The log is written through the C library's buffering so that recording
+*		a frame does not cost a system call.
+*
+*	Parameters:
+*
+*	trace		I/O	A pointer to the trace object to open.
+*	prefix		I/P	The path and name prefix of the frame log.
+*
+*	Returns:
+*	int			0 if the log was opened successfully, 1 otherwise.
+*				Failure may occur due to:
+*					not being able to create the log,
+*					not being able to write the header.
+*******************************************************************************/
+int trace_open(Trace_ts* trace, char* prefix) {
+	char path[MAX_PATH];
+	Trace_Header_ts hdr;
+	SYSTEMTIME local;
+	FILETIME now;
+	ULARGE_INTEGER ticks;
+
+	if(trace == NULL) return 1;
+
+	trace->start = GetTickCount();
+	GetSystemTimeAsFileTime(&now);
+	GetLocalTime(&local);
+
+	snprintf(path, sizeof(path), "%s-%04u%02u%02u-%02u%02u%02u.trc", prefix,
+		local.wYear, local.wMonth, local.wDay, local.wHour, local.wMinute,
+		local.wSecond);
+	trace->fp = fopen(path, "wb");
+	if(trace->fp == NULL) {
+		fprintf(stderr, "Error opening frame log %s\n", path);
+		return 1;
+	}
+
+	/* FILETIME counts 100 ns intervals since 1601-01-01 */
+	ticks.LowPart = now.dwLowDateTime;
+	ticks.HighPart = now.dwHighDateTime;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = TRACE_MAGIC;
+	hdr.version = TRACE_VERSION;
+	hdr.recordSize = sizeof(Trace_Record_ts);
+	hdr.startTime = (ticks.QuadPart - 116444736000000000ULL) / 10000;
+	if(fwrite(&hdr, sizeof(hdr), 1, trace->fp) != 1) {
+		fprintf(stderr, "Error writing frame log %s\n", path);
+		trace_close(trace);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*******************************************************************************
+*	void trace_close(Trace_ts* trace)
+*
+*	Description: Flushes any buffered records and closes the frame log.
+*
+*	Parameters:
+*
+*	trace		I/O	A pointer to the trace object to close.
+*
+*******************************************************************************/
+void trace_close(Trace_ts* trace) {
+	if(trace->fp == NULL) return;
+
+	if(fclose(trace->fp) != 0)
+		fprintf(stderr, "Error closing frame log\n");
+	trace->fp = NULL;
+}
+
+/*******************************************************************************
+*	void trace_record(Trace_ts* trace, int8_t bytes[])
+*
+*	Description:	Appends the frame passed as the second argument to the
+*					trace object passed as the first argument.
+*
+*		The record is stamped with the milliseconds elapsed since the log was
+*		opened.  Callers must serialize calls so that records are written in
+*		the order the frames were sent.
+*
+*	Parameters:
+*
+*	trace		I/O	A pointer to the trace object to record to.
+*	bytes		I/P	The 3 byte frame that was sent to the base.
+*
+*******************************************************************************/
+void trace_record(Trace_ts* trace, int8_t bytes[]) {
+	Trace_Record_ts rec;
+
+	if(trace->fp == NULL) return;
+
+	rec.time = GetTickCount() - trace->start;
+	memcpy(rec.bytes, bytes, sizeof(rec.bytes));
+	rec.reserved = 0;
+	fwrite(&rec, sizeof(rec), 1, trace->fp);
+}
@@ -0,0 +1,136 @@
+/*******************************************************************************
+*	trace.h
+*	Author: Joshua Newhouse
+*
+*	Tab width: 4
+*
+*	Purpose:
+*
+*	This module defines a trace class which records every command frame sent
+*	to the base controller into a frame log for later offline analysis.
+*
+*	Every run of the controller writes a new frame log named after the time
+*	it was started, so earlier captures are kept.  A frame log is a
+*	Trace_Header_ts followed by a flat array of fixed size Trace_Record_ts
+*	records in the order the frames were sent.  The fixed size lets a reader
+*	split a log at any record boundary without scanning it.
+*
+*	Data Types:
+*
+*	Trace_Header_ts		structure used to identify a log and its start time.
+*	Trace_Record_ts		structure used to store a single frame in a log.
+*	Trace_ts			structure used to model an open frame log.
+*
+*	Procedures:
+*
+*	trace_open			Opens a Trace_ts.
+*	trace_close			Closes a Trace_ts.
+*	trace_record		Appends a frame to the Trace_ts.
+*******************************************************************************/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdint.h>
+
+/* Identifies a frame log and the layout of its records.  The version must be
+	changed whenever Trace_Header_ts or Trace_Record_ts is. */
+#define TRACE_MAGIC 0x43525454		/* "TTRC" */
+#define TRACE_VERSION 1
+
+/**
+* Trace_Header_ts:
+*	Fields:
+*		uint32_t	TRACE_MAGIC.
+*
+*		uint16_t	TRACE_VERSION.
+*
+*		uint16_t	Size of a Trace_Record_ts in bytes.
+*
+*		uint64_t	Wall clock time the log was opened, in ms since
+*					1970-01-01 00:00 UTC.  Record times are relative to it.
+*/
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t recordSize;
+	uint64_t startTime;
+} Trace_Header_ts;
+
+/**
+* Trace_Record_ts:
+*	Fields:
+*		uint32_t	Milliseconds since the log was opened when the frame was
+*					sent.  Stored in the byte order of the host.
+*
+*		int8_t[3]	The 3 byte command frame as sent to the base.
+*
+*		uint8_t		Reserved, always 0.
+*/
+typedef struct {
+	uint32_t time;
+	int8_t bytes[3];
+	uint8_t reserved;
+} Trace_Record_ts;
+
+/**
+* Trace_ts:
+*	Fields:
+*		FILE*	The open frame log, NULL if tracing is disabled.
+*
+*		DWORD	Tick count when the log was opened.
+*/
+typedef struct {
+	FILE* fp;
+	DWORD start;
+} Trace_ts;
+
+/*******************************************************************************
+*	trace_open
+*
+*	Description: Opens a new frame log for writing, named after the prefix
+*	passed and the current local time, e.g. train-20261019-143005.trc.
+*
+*	Parameters:
+*
+*	Trace_ts*	A pointer to the trace object to open.
+*
+*	char*		The path and name prefix of the frame log.
+*
+*	Returns:
+*
+*	int			0 if the log was opened successfully, 1 otherwise.  On failure
+*				the trace object is left disabled and may still be passed to
+*				trace_record and trace_close.
+*******************************************************************************/
+int trace_open(Trace_ts*, char*);
+
+/*******************************************************************************
+*	trace_close
+*
+*	Description:	Flushes and closes the trace object.
+*
+*	Parameters:
+*
+*	Trace_ts*		The trace object to close.
+*
+*******************************************************************************/
+void trace_close(Trace_ts*);
+
+/*******************************************************************************
+*	trace_record
+*
+*	Description:	Appends a 3 byte command frame, stamped with the current
+*					time, to the trace object.
+*
+*	Parameters:
+*
+*	Trace_ts*	The trace object to record to.
+*
+*	int8_t[]	The 3 byte frame that was sent to the base.
+*
+*******************************************************************************/
+void trace_record(Trace_ts*, int8_t[]);
+
+#endif
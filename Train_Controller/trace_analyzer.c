@@ -0,0 +1,964 @@
+/*******************************************************************************
+*	trace_analyzer.c
+*	Author: Joshua Newhouse
+*
+*	Tab width: 4
+*
+*	Purpose:
+*
+*	This implements a command line tool for analyzing frame logs recorded by
+*	the trace module.
+*
+*	Usage:
+*
+*	trace_analyzer [-b seconds] [-a address] [-j threads] log...
+*
+*		-b	Width of a time bucket in seconds, default 1.
+*		-a	Only count frames sent to this target address in the time
+*			buckets, for a speed timeline of a single train.  Without it
+*			the buckets have no speed, since several trains may share them.
+*		-j	Number of worker threads, default one per processor.
+*
+*	Several logs, such as those of consecutive runs of the controller, may be
+*	given in the order they were recorded.  They are reported together on the
+*	wall clock time recorded in their headers.
+*
+*	Each log is memory mapped one window of WINDOW_RECORDS records at a time.
+*	Each window is split into one slice per worker thread and every slice is
+*	processed in parallel in two passes:
+*		the speed pass finds, for every train, its speed at the end of the
+*		slice for each speed it may have had at the start,
+*		the decode pass, given the actual speeds at the start of the slice,
+*		collects the statistics and time buckets of the slice.
+*	The workers are started once and fed windows through events.  While the
+*	results of a window are merged in log order the speed pass of the next
+*	window already runs, which also brings its pages in from the disk.  Memory
+*	use does not depend on the size of the logs.
+*
+*	The report contains one line per non-empty time bucket followed by totals
+*	for all the logs and for every target address seen in them.  A bucket is
+*	flagged as saturated when its frame rate reaches SATURATION_PCT percent
+*	of what the serial link to the base can carry.
+*
+*	Procedures:
+*
+*	main				contains the beginning of the code.
+*	analyzeLog			reports a single log.
+*	mapWindow			maps a window of a log.
+*	setSlices			splits a window between the workers.
+*	startPhase			starts a pass of the workers.
+*	waitPhase			waits for a pass of the workers to finish.
+*	workerThread		runs the passes of a worker.
+*	speedPass			finds the speed each train ends a slice at.
+*	decodePass			decodes a slice of a window of the log.
+*	cmdIndex			maps a command to its column in the report.
+*	isSpeedCmd			tells whether a command changes the speed of a train.
+*	parseLong			parses a bounded integer option.
+*	stats_reset			clears a Stats_ts.
+*	stats_merge			merges the statistics of a later slice into a Stats_ts.
+*	emitBucket			merges a bucket into the report.
+*	printBucket			prints a single time bucket.
+*	printTime			prints a wall clock time.
+*	printSpan			prints a length of time.
+*	printSummary		prints the totals for the logs.
+*******************************************************************************/
+
+#include <windows.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "target.h"
+#include "trace.h"
+
+/* Number of records mapped at once; 8 MB, a multiple of the allocation
+	granularity so that every window starts on a valid mapping offset. */
+#define WINDOW_RECORDS (1 << 20)
+
+/* Number of addresses a target can have */
+#define MAX_TARGETS 128
+
+/* Number of speeds a train can have, [0,1F] */
+#define SPEEDS 0x20
+
+/* Frames per second the link can carry: 9600 baud, 10 bits per byte and 3
+	bytes per frame. */
+#define LINK_FRAMES_PER_SEC 320
+#define SATURATION_PCT 90
+
+typedef enum {
+	CMD_ABSSPD,
+	CMD_RELSPD,
+	CMD_FORWARD,
+	CMD_REVERSE,
+	CMD_TOGGLE,
+	CMD_BRAKE,
+	CMD_BOOST,
+	CMD_HORN1,
+	CMD_HORN2,
+	CMD_COUNT
+} analyzer_Cmd_te;
+
+static const char* cmdNames[CMD_COUNT] = {
+	"abs", "rel", "fwd", "rev", "tog", "brk", "bst", "hn1", "hn2"
+};
+
+typedef enum {
+	PHASE_SPEED,
+	PHASE_DECODE,
+	PHASE_EXIT
+} analyzer_Phase_te;
+
+/**
+* Train_Stats_ts:
+*	Fields:
+*		uint64_t	Number of frames sent to this target.
+*
+*		uint64_t[]	Number of frames of each command.
+*
+*		uint64_t	Number of times the speed of the target changed.
+*
+*		int			Speed after the last command that set it, -1 if none.
+*
+*		uint64_t	Wall clock times of the first and last frame.
+*/
+typedef struct {
+	uint64_t frames;
+	uint64_t cmds[CMD_COUNT];
+	uint64_t speedChanges;
+	int lastSpeed;
+	uint64_t firstTime;
+	uint64_t lastTime;
+} Train_Stats_ts;
+
+/**
+* Stats_ts:
+*	Fields:
+*		uint64_t	Number of valid frames, SYSTEM_HALT frames and frames that
+*					could not be decoded.
+*
+*		uint64_t	Wall clock times of the first and last valid frame.
+*
+*		Train_Stats_ts[]	Statistics for each target address.
+*/
+typedef struct {
+	uint64_t frames;
+	uint64_t halts;
+	uint64_t invalid;
+	uint64_t firstTime;
+	uint64_t lastTime;
+	Train_Stats_ts trains[MAX_TARGETS];
+} Stats_ts;
+
+/**
+* Bucket_ts:
+*	Fields:
+*		uint64_t	Index of the bucket; its wall clock start time divided by
+*					its width.
+*
+*		uint32_t	Number of frames and of speed commands in the bucket.
+*
+*		int32_t		Speed after the last command in the bucket that set it,
+*					-1 if none or if no address filter is set.
+*/
+typedef struct {
+	uint64_t index;
+	uint32_t frames;
+	uint32_t speedCmds;
+	int32_t speed;
+} Bucket_ts;
+
+/**
+* Window_ts:
+*	Fields:
+*		void*		The mapped view, starting on an allocation boundary.
+*
+*		const Trace_Record_ts*	The first record of the window in the view.
+*
+*		size_t		Number of records in the window.
+*/
+typedef struct {
+	void* view;
+	const Trace_Record_ts* recs;
+	size_t count;
+} Window_ts;
+
+/**
+* Worker_ts:
+*	Fields:
+*		const Trace_Record_ts*	The slice of the log to process.
+*
+*		size_t		Number of records in the slice.
+*
+*		uint64_t	Wall clock start time of the log.
+*
+*		analyzer_Phase_te	The pass to run when started.
+*
+*		uint8_t[][]	Output of the speed pass; the speed of each train at the
+*					end of the slice for each speed it had at its start.
+*
+*		uint8_t[]	Input of the decode pass; the speed of each train at the
+*					start of the slice.
+*
+*		Stats_ts	Statistics for the slice.
+*
+*		Bucket_ts*	Time buckets of the slice in log order.  Sized for one
+*					bucket per record so it can never overflow.
+*
+*		size_t		Number of time buckets of the slice.
+*
+*		HANDLE		Events signalled to start a pass and when it is done.
+*
+*		HANDLE		The worker thread.
+*/
+typedef struct {
+	const Trace_Record_ts* recs;
+	size_t count;
+	uint64_t startTime;
+	analyzer_Phase_te phase;
+	uint8_t speedOut[MAX_TARGETS][SPEEDS];
+	uint8_t speedIn[MAX_TARGETS];
+	Stats_ts stats;
+	Bucket_ts* buckets;
+	size_t nBuckets;
+	HANDLE start;
+	HANDLE done;
+	HANDLE thread;
+} Worker_ts;
+
+/* functions declaration */
+int analyzeLog(char*);
+int mapWindow(HANDLE, uint64_t, uint64_t, Window_ts*);
+void setSlices(const Window_ts*);
+void startPhase(analyzer_Phase_te);
+void waitPhase(void);
+DWORD WINAPI workerThread(void*);
+void speedPass(Worker_ts*);
+void decodePass(Worker_ts*);
+int cmdIndex(target_CmdType_te);
+int isSpeedCmd(target_CmdType_te);
+int parseLong(char*, long, long, long*);
+void stats_reset(Stats_ts*);
+void stats_merge(Stats_ts*, const Stats_ts*);
+void emitBucket(const Bucket_ts*);
+void printBucket(const Bucket_ts*);
+void printTime(uint64_t);
+void printSpan(uint64_t);
+void printSummary(void);
+
+/* Options shared read-only with the workers */
+static uint32_t bucketMs = 1000;
+static int filter = -1;
+
+/* The workers and their done events, for waiting on all of them */
+static Worker_ts* workers;
+static HANDLE* doneEvents;
+static int nThreads;
+
+/* Merged results; pending holds the last bucket seen since the next slice
+	may still add to it. */
+static Stats_ts total;
+static Bucket_ts pending;
+static int havePending = 0;
+static uint64_t saturated = 0;
+static uint64_t trailing = 0;
+
+/* main function */
+int main(int argc, char* argv[]) {
+	SYSTEM_INFO sysInfo;
+	char** paths;
+	int nPaths = 0;
+	int usage = 0;
+	int ret_val = EXIT_SUCCESS;
+	long value;
+	int i;
+
+	GetSystemInfo(&sysInfo);
+	nThreads = (int)sysInfo.dwNumberOfProcessors;
+	if(nThreads > MAXIMUM_WAIT_OBJECTS) nThreads = MAXIMUM_WAIT_OBJECTS;
+
+	paths = calloc(argc, sizeof(char*));
+	if(paths == NULL) {
+		fprintf(stderr, "Error allocating paths\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* parse options */
+	for(i = 1; i < argc && !usage; i++) {
+		if(strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			char* end;
+			double ms = strtod(argv[++i], &end) * 1000;
+			if(*end != '\0' || !(ms >= 1 && ms <= UINT32_MAX))
+				usage = 1;
+			else
+				bucketMs = (uint32_t)ms;
+		}
+		else if(strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+			usage = parseLong(argv[++i], 0, MAX_TARGETS - 1, &value);
+			filter = (int)value;
+		}
+		else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			usage = parseLong(argv[++i], 1, MAXIMUM_WAIT_OBJECTS, &value);
+			nThreads = (int)value;
+		}
+		else if(argv[i][0] != '-') {
+			paths[nPaths++] = argv[i];
+		}
+		else {
+			usage = 1;
+		}
+	}
+
+	if(usage || nPaths == 0) {
+		fprintf(stderr, "Usage: %s [-b seconds] [-a address] [-j threads] "
+			"log...\n", argv[0]);
+		fprintf(stderr, "\tseconds: at least 0.001\n"
+			"\taddress: 0 to %d\n\tthreads: 1 to %d\n",
+			MAX_TARGETS - 1, MAXIMUM_WAIT_OBJECTS);
+		exit(EXIT_FAILURE);
+	}
+
+	/* Start the workers; each one gets a fixed slice of every window */
+	size_t slice = (WINDOW_RECORDS + nThreads - 1) / nThreads;
+	workers = calloc(nThreads, sizeof(Worker_ts));
+	doneEvents = calloc(nThreads, sizeof(HANDLE));
+	if(workers == NULL || doneEvents == NULL) {
+		fprintf(stderr, "Error allocating workers\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(i = 0; i < nThreads; i++) {
+		Worker_ts* w = &workers[i];
+		w->buckets = malloc(slice * sizeof(Bucket_ts));
+		w->start = CreateEvent(NULL, FALSE, FALSE, NULL);
+		w->done = CreateEvent(NULL, FALSE, FALSE, NULL);
+		if(w->buckets == NULL || w->start == NULL || w->done == NULL) {
+			fprintf(stderr, "Error allocating workers\n");
+			exit(EXIT_FAILURE);
+		}
+
+		w->thread = CreateThread(NULL, 0, workerThread, w, 0, NULL);
+		if(w->thread == NULL) {
+			fprintf(stderr, "Error creating worker thread\n");
+			exit(EXIT_FAILURE);
+		}
+		doneEvents[i] = w->done;
+	}
+
+	stats_reset(&total);
+	printf("%-23s %10s %10s %8s %6s\n",
+		"Bucket", "Frames", "Frames/s", "SpdCmds", "Speed");
+
+	for(i = 0; i < nPaths; i++)
+		if(analyzeLog(paths[i]) != 0)
+			ret_val = EXIT_FAILURE;
+
+	if(havePending)
+		printBucket(&pending);
+
+	printSummary();
+
+	/* Stop the workers */
+	startPhase(PHASE_EXIT);
+	for(i = 0; i < nThreads; i++) {
+		WaitForSingleObject(workers[i].thread, INFINITE);
+		CloseHandle(workers[i].thread);
+		CloseHandle(workers[i].start);
+		CloseHandle(workers[i].done);
+		free(workers[i].buckets);
+	}
+	free(doneEvents);
+	free(workers);
+	free(paths);
+	exit(ret_val);
+}
+
+/*******************************************************************************
+*	int analyzeLog(char* path)
+*
+*	Description:	Checks the header of the log at path and then merges all of
+*					its records into the report, one window at a time.
+*
+*		Every train starts the log stopped, since the controller starts with
+*		a speed of 0.  The speed of each train at the start of each slice is
+*		found by passing its speed at the start of the window through the
+*		speed pass results of every earlier slice of the window.  Once the
+*		decode pass of a window is done, the next window is mapped and its
+*		speed pass started, and only then is the window merged.  The speed
+*		pass writes only speedOut, so it does not disturb the statistics and
+*		buckets being merged.
+*
+*	Parameters:
+*	path	The path of the log.
+*
+*	Returns:
+*	int		0 if the log was read successfully, 1 otherwise.
+*
+*******************************************************************************/
+int analyzeLog(char* path) {
+	Trace_Header_ts hdr;
+	LARGE_INTEGER size;
+	DWORD bytesRead = 0;
+	uint8_t speeds[MAX_TARGETS];
+	Window_ts cur, next;
+	int ret_val = 0;
+	int a, i;
+
+	/* The log of the current run is still open for writing by the controller;
+		a partly written record at its end is counted as trailing bytes. */
+	HANDLE hFile = CreateFile(path, GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(hFile == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Error opening %s\n", path);
+		return 1;
+	}
+
+	if(GetFileSizeEx(hFile, &size) == 0 ||
+			!ReadFile(hFile, &hdr, sizeof(hdr), &bytesRead, NULL) ||
+			bytesRead != sizeof(hdr) || hdr.magic != TRACE_MAGIC ||
+			hdr.version != TRACE_VERSION ||
+			hdr.recordSize != sizeof(Trace_Record_ts)) {
+		fprintf(stderr, "Error %s is not a version %d frame log\n", path,
+			TRACE_VERSION);
+		CloseHandle(hFile);
+		return 1;
+	}
+
+	uint64_t bytes = (uint64_t)size.QuadPart - sizeof(hdr);
+	uint64_t nRecords = bytes / sizeof(Trace_Record_ts);
+	trailing += bytes % sizeof(Trace_Record_ts);
+	if(nRecords == 0) {
+		CloseHandle(hFile);
+		return 0;
+	}
+
+	HANDLE hMap = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(hMap == NULL || mapWindow(hMap, nRecords, 0, &cur) != 0) {
+		fprintf(stderr, "Error mapping %s\n", path);
+		if(hMap != NULL)
+			CloseHandle(hMap);
+		CloseHandle(hFile);
+		return 1;
+	}
+
+	for(i = 0; i < nThreads; i++)
+		workers[i].startTime = hdr.startTime;
+	memset(speeds, 0, sizeof(speeds));
+
+	setSlices(&cur);
+	startPhase(PHASE_SPEED);
+	waitPhase();
+
+	uint64_t first;
+	for(first = 0; first < nRecords; first += WINDOW_RECORDS) {
+		/* Pass the speeds at the start of the window through the slices */
+		for(i = 0; i < nThreads; i++) {
+			Worker_ts* w = &workers[i];
+			memcpy(w->speedIn, speeds, sizeof(speeds));
+			for(a = 0; a < MAX_TARGETS; a++)
+				speeds[a] = w->speedOut[a][speeds[a]];
+		}
+
+		startPhase(PHASE_DECODE);
+		waitPhase();
+
+		/* Start on the next window while this one is merged */
+		int haveNext = 0;
+		if(first + WINDOW_RECORDS < nRecords) {
+			if(mapWindow(hMap, nRecords, first + WINDOW_RECORDS, &next) != 0) {
+				fprintf(stderr, "Error mapping %s at record %llu\n", path,
+					(unsigned long long)(first + WINDOW_RECORDS));
+				ret_val = 1;
+			}
+			else {
+				haveNext = 1;
+				setSlices(&next);
+				startPhase(PHASE_SPEED);
+			}
+		}
+
+		/* Merge the slices in log order */
+		for(i = 0; i < nThreads; i++) {
+			size_t b;
+			stats_merge(&total, &workers[i].stats);
+			for(b = 0; b < workers[i].nBuckets; b++)
+				emitBucket(&workers[i].buckets[b]);
+		}
+
+		UnmapViewOfFile(cur.view);
+		if(!haveNext)
+			break;
+
+		waitPhase();
+		cur = next;
+	}
+
+	CloseHandle(hMap);
+	CloseHandle(hFile);
+	return ret_val;
+}
+
+/*******************************************************************************
+*	int mapWindow(HANDLE hMap, uint64_t nRecords, uint64_t first,
+*		Window_ts* win)
+*
+*	Description:	Maps the window of the log starting at record first.  The
+*					view starts on the allocation boundary before the window,
+*					which is the size of the log header before it.
+*
+*	Parameters:
+*	hMap		The mapping of the log.
+*	nRecords	Number of records in the log.
+*	first		The first record of the window.
+*	win			Receives the window.
+*
+*	Returns:
+*	int			0 if the window was mapped successfully, 1 otherwise.
+*
+*******************************************************************************/
+int mapWindow(HANDLE hMap, uint64_t nRecords, uint64_t first, Window_ts* win) {
+	uint64_t offset = first * sizeof(Trace_Record_ts);
+
+	win->count = nRecords - first < WINDOW_RECORDS ?
+		(size_t)(nRecords - first) : WINDOW_RECORDS;
+	win->view = MapViewOfFile(hMap, FILE_MAP_READ, (DWORD)(offset >> 32),
+		(DWORD)offset,
+		sizeof(Trace_Header_ts) + win->count * sizeof(Trace_Record_ts));
+	if(win->view == NULL)
+		return 1;
+
+	win->recs = (const Trace_Record_ts*)
+		((const char*)win->view + sizeof(Trace_Header_ts));
+	return 0;
+}
+
+/*******************************************************************************
+*	void setSlices(const Window_ts* win)
+*
+*	Description:	Splits the window into one slice per worker.  Workers past
+*					the end of the window get an empty slice.
+*
+*******************************************************************************/
+void setSlices(const Window_ts* win) {
+	size_t slice = (WINDOW_RECORDS + nThreads - 1) / nThreads;
+	size_t start = 0;
+	int i;
+
+	for(i = 0; i < nThreads; i++) {
+		Worker_ts* w = &workers[i];
+		w->recs = win->recs + start;
+		w->count = win->count - start < slice ? win->count - start : slice;
+		start += w->count;
+	}
+}
+
+/*******************************************************************************
+*	void startPhase(analyzer_Phase_te phase)
+*
+*	Description:	Starts the pass phase on every worker.
+*
+*******************************************************************************/
+void startPhase(analyzer_Phase_te phase) {
+	int i;
+
+	for(i = 0; i < nThreads; i++) {
+		workers[i].phase = phase;
+		SetEvent(workers[i].start);
+	}
+}
+
+/*******************************************************************************
+*	void waitPhase(void)
+*
+*	Description:	Waits for every worker to finish the pass it was started on.
+*
+*******************************************************************************/
+void waitPhase(void) {
+	WaitForMultipleObjects(nThreads, doneEvents, TRUE, INFINITE);
+}
+
+/*******************************************************************************
+*	DWORD WINAPI workerThread(void* arg)
+*
+*	Description:	Runs the pass set on the Worker_ts passed as the argument
+*					each time its start event is signalled, and then signals its
+*					done event, until it is started on PHASE_EXIT.
+*
+*		Only records within the slice are read and only the worker's own
+*		results are written, so workers never share any writable data.
+*
+*	Parameters:
+*	arg		The Worker_ts to run.
+*
+*******************************************************************************/
+DWORD WINAPI workerThread(void* arg) {
+	Worker_ts* w = arg;
+
+	for(;;) {
+		WaitForSingleObject(w->start, INFINITE);
+
+		if(w->phase == PHASE_EXIT)
+			break;
+		else if(w->phase == PHASE_SPEED)
+			speedPass(w);
+		else
+			decodePass(w);
+
+		SetEvent(w->done);
+	}
+
+	return 0;
+}
+
+/*******************************************************************************
+*	void speedPass(Worker_ts* w)
+*
+*	Description:	Finds the speed each train has at the end of the slice of w
+*					for every speed it may have had at its start, by applying
+*					every speed command of the slice to each of them.
+*
+*******************************************************************************/
+void speedPass(Worker_ts* w) {
+	size_t r;
+	int a, s;
+
+	for(a = 0; a < MAX_TARGETS; a++)
+		for(s = 0; s < SPEEDS; s++)
+			w->speedOut[a][s] = (uint8_t)s;
+
+	for(r = 0; r < w->count; r++) {
+		uint8_t adr, data;
+		target_CmdType_te cmd;
+
+		if(target_decode(w->recs[r].bytes, &adr, &cmd, &data) != 0 ||
+				!isSpeedCmd(cmd))
+			continue;
+
+		uint8_t* out = w->speedOut[adr];
+		for(s = 0; s < SPEEDS; s++)
+			out[s] = target_applySpeed(cmd, data, out[s]);
+	}
+}
+
+/*******************************************************************************
+*	void decodePass(Worker_ts* w)
+*
+*	Description:	Decodes every record in the slice of w, collecting its
+*					statistics and time buckets.  The speed of each train is
+*					followed with target_applySpeed from its speed at the start
+*					of the slice.
+*
+*******************************************************************************/
+void decodePass(Worker_ts* w) {
+	Stats_ts* s = &w->stats;
+	Bucket_ts* bucket = NULL;
+	uint8_t speeds[MAX_TARGETS];
+	size_t r;
+
+	stats_reset(s);
+	w->nBuckets = 0;
+	memcpy(speeds, w->speedIn, sizeof(speeds));
+
+	for(r = 0; r < w->count; r++) {
+		const Trace_Record_ts* rec = &w->recs[r];
+		uint64_t t = w->startTime + rec->time;
+		uint8_t adr, data;
+		target_CmdType_te cmd;
+		int speed = -1;
+
+		if(target_decode(rec->bytes, &adr, &cmd, &data) != 0) {
+			s->invalid++;
+			continue;
+		}
+
+		if(s->frames++ == 0)
+			s->firstTime = t;
+		s->lastTime = t;
+
+		if(cmd == SYSTEM_HALT) {
+			s->halts++;
+		}
+		else {
+			Train_Stats_ts* ts = &s->trains[adr];
+			if(ts->frames++ == 0)
+				ts->firstTime = t;
+			ts->lastTime = t;
+			ts->cmds[cmdIndex(cmd)]++;
+
+			if(isSpeedCmd(cmd)) {
+				speed = target_applySpeed(cmd, data, speeds[adr]);
+				if(speed != speeds[adr])
+					ts->speedChanges++;
+				speeds[adr] = (uint8_t)speed;
+				ts->lastSpeed = speed;
+			}
+		}
+
+		if(filter >= 0 && (cmd == SYSTEM_HALT || adr != filter))
+			continue;
+
+		uint64_t index = t / bucketMs;
+		if(bucket == NULL || bucket->index != index) {
+			bucket = &w->buckets[w->nBuckets++];
+			bucket->index = index;
+			bucket->frames = 0;
+			bucket->speedCmds = 0;
+			bucket->speed = -1;
+		}
+
+		bucket->frames++;
+		if(cmd == TRAIN_ABSSPD || cmd == TRAIN_RELSPD)
+			bucket->speedCmds++;
+		if(speed >= 0 && filter >= 0)
+			bucket->speed = speed;
+	}
+}
+
+/*******************************************************************************
+*	int cmdIndex(target_CmdType_te cmd)
+*
+*	Description:	Returns the report column of the command passed as the
+*					argument.  The command must not be SYSTEM_HALT.
+*
+*******************************************************************************/
+int cmdIndex(target_CmdType_te cmd) {
+	switch(cmd) {
+	case TRAIN_ABSSPD:	return CMD_ABSSPD;
+	case TRAIN_RELSPD:	return CMD_RELSPD;
+	case TRAIN_FORWARD:	return CMD_FORWARD;
+	case TRAIN_REVERSE:	return CMD_REVERSE;
+	case TRAIN_TOGGLE:	return CMD_TOGGLE;
+	case TRAIN_BRAKE:	return CMD_BRAKE;
+	case TRAIN_BOOST:	return CMD_BOOST;
+	case TRAIN_HORN1:	return CMD_HORN1;
+	default:			return CMD_HORN2;
+	}
+}
+
+/*******************************************************************************
+*	int isSpeedCmd(target_CmdType_te cmd)
+*
+*	Description:	Returns 1 if target_applySpeed may change the speed of a
+*					train for the command passed as the argument, 0 otherwise.
+*
+*******************************************************************************/
+int isSpeedCmd(target_CmdType_te cmd) {
+	return cmd == TRAIN_ABSSPD || cmd == TRAIN_RELSPD || cmd == TRAIN_TOGGLE;
+}
+
+/*******************************************************************************
+*	int parseLong(char* str, long lo, long hi, long* value)
+*
+*	Description:	Parses str as a decimal integer in the range [lo,hi].
+*
+*	Parameters:
+*	str		The string to parse.
+*	lo		The smallest valid value.
+*	hi		The largest valid value.
+*	value	Receives the value.
+*
+*	Returns:
+*	int		0 if str is a valid value, 1 otherwise.
+*
+*******************************************************************************/
+int parseLong(char* str, long lo, long hi, long* value) {
+	char* end;
+
+	*value = strtol(str, &end, 10);
+	return end == str || *end != '\0' || *value < lo || *value > hi;
+}
+
+/*******************************************************************************
+*	void stats_reset(Stats_ts* s)
+*
+*	Description:	Clears the statistics passed as the argument.
+*
+*******************************************************************************/
+void stats_reset(Stats_ts* s) {
+	int a;
+
+	memset(s, 0, sizeof(*s));
+	for(a = 0; a < MAX_TARGETS; a++)
+		s->trains[a].lastSpeed = -1;
+}
+
+/*******************************************************************************
+*	void stats_merge(Stats_ts* into, const Stats_ts* from)
+*
+*	Description:	Merges the statistics of a slice, from, into the statistics
+*					of every slice before it, into.  Speed changes across the
+*					two need no special care since the decode pass of a slice
+*					already starts from the speeds the slices before it ended at.
+*
+*	Parameters:
+*	into	The statistics of the earlier part of the logs.
+*	from	The statistics of the slice that immediately follows it.
+*
+*******************************************************************************/
+void stats_merge(Stats_ts* into, const Stats_ts* from) {
+	int a, c;
+
+	if(from->frames > 0) {
+		if(into->frames == 0)
+			into->firstTime = from->firstTime;
+		into->lastTime = from->lastTime;
+	}
+	into->frames += from->frames;
+	into->halts += from->halts;
+	into->invalid += from->invalid;
+
+	for(a = 0; a < MAX_TARGETS; a++) {
+		Train_Stats_ts* i = &into->trains[a];
+		const Train_Stats_ts* f = &from->trains[a];
+
+		if(f->frames == 0) continue;
+
+		if(i->frames == 0)
+			i->firstTime = f->firstTime;
+		i->lastTime = f->lastTime;
+		i->frames += f->frames;
+		for(c = 0; c < CMD_COUNT; c++)
+			i->cmds[c] += f->cmds[c];
+
+		i->speedChanges += f->speedChanges;
+		if(f->lastSpeed >= 0)
+			i->lastSpeed = f->lastSpeed;
+	}
+}
+
+/*******************************************************************************
+*	void emitBucket(const Bucket_ts* b)
+*
+*	Description:	Adds the bucket passed as the argument to the report.  It
+*					is merged into the pending bucket when both share an index,
+*					which happens when a bucket spans two slices.  Otherwise the
+*					pending bucket is complete and is printed.
+*
+*******************************************************************************/
+void emitBucket(const Bucket_ts* b) {
+	if(havePending && pending.index == b->index) {
+		pending.frames += b->frames;
+		pending.speedCmds += b->speedCmds;
+		if(b->speed >= 0)
+			pending.speed = b->speed;
+		return;
+	}
+
+	if(havePending)
+		printBucket(&pending);
+	pending = *b;
+	havePending = 1;
+}
+
+/*******************************************************************************
+*	void printBucket(const Bucket_ts* b)
+*
+*	Description:	Prints a single time bucket, flagging it if the link was
+*					saturated during it.
+*
+*******************************************************************************/
+void printBucket(const Bucket_ts* b) {
+	double rate = b->frames * 1000.0 / bucketMs;
+	int sat = (uint64_t)b->frames * 1000 * 100 >=
+		(uint64_t)LINK_FRAMES_PER_SEC * SATURATION_PCT * bucketMs;
+
+	printTime(b->index * bucketMs);
+	printf(" %10lu %10.1f %8lu ", (unsigned long)b->frames, rate,
+		(unsigned long)b->speedCmds);
+	if(b->speed >= 0)
+		printf("%6ld", (long)b->speed);
+	else
+		printf("%6s", "-");
+	printf("%s\n", sat ? "  SATURATED" : "");
+
+	saturated += sat;
+}
+
+/*******************************************************************************
+*	void printTime(uint64_t ms)
+*
+*	Description:	Prints a wall clock time, in ms since 1970-01-01 00:00 UTC,
+*					as the local date and time, 23 characters wide.
+*
+*******************************************************************************/
+void printTime(uint64_t ms) {
+	time_t secs = (time_t)(ms / 1000);
+	struct tm* local = localtime(&secs);
+	char text[20];
+
+	if(local == NULL || strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S",
+			local) == 0)
+		strcpy(text, "invalid time");
+	printf("%19s.%03u", text, (unsigned)(ms % 1000));
+}
+
+/*******************************************************************************
+*	void printSpan(uint64_t ms)
+*
+*	Description:	Prints a length of time as days, hours, minutes, seconds
+*					and milliseconds.
+*
+*******************************************************************************/
+void printSpan(uint64_t ms) {
+	unsigned long s = (unsigned long)(ms / 1000);
+
+	printf("%lud %02lu:%02lu:%02lu.%03lu", s / 86400, s / 3600 % 24,
+		s / 60 % 60, s % 60, (unsigned long)(ms % 1000));
+}
+
+/*******************************************************************************
+*	void printSummary(void)
+*
+*	Description:	Prints the totals for the logs and for every target address
+*					that was sent at least one frame.  Rates are taken over the
+*					span between the first and last frame.
+*
+*******************************************************************************/
+void printSummary(void) {
+	double span = (total.lastTime - total.firstTime) / 1000.0;
+	double rate = span > 0 ? total.frames / span : 0;
+	int a, c;
+
+	printf("\nRecords:      %llu (%llu invalid, %llu trailing bytes ignored)\n",
+		(unsigned long long)(total.frames + total.invalid),
+		(unsigned long long)total.invalid, (unsigned long long)trailing);
+	printf("Saturated:    %llu buckets\n", (unsigned long long)saturated);
+	if(total.frames > 0) {
+		printf("First frame:  ");
+		printTime(total.firstTime);
+		printf("\nLast frame:   ");
+		printTime(total.lastTime);
+		printf("\n");
+	}
+	printf("Span:         ");
+	printSpan(total.lastTime - total.firstTime);
+	printf("\nFrames:       %llu (%llu halt)\n",
+		(unsigned long long)total.frames, (unsigned long long)total.halts);
+	printf("Frames/s:     %.2f (%.1f%% of link)\n", rate,
+		rate * 100 / LINK_FRAMES_PER_SEC);
+
+	printf("\n%4s %10s %9s %8s %5s", "Addr", "Frames", "Frames/s", "SpdChg",
+		"Speed");
+	for(c = 0; c < CMD_COUNT; c++)
+		printf(" %8s", cmdNames[c]);
+	printf("\n");
+
+	for(a = 0; a < MAX_TARGETS; a++) {
+		const Train_Stats_ts* ts = &total.trains[a];
+		if(ts->frames == 0) continue;
+
+		span = (ts->lastTime - ts->firstTime) / 1000.0;
+		printf("%4d %10llu %9.2f %8llu ", a, (unsigned long long)ts->frames,
+			span > 0 ? ts->frames / span : 0,
+			(unsigned long long)ts->speedChanges);
+		if(ts->lastSpeed >= 0)
+			printf("%5d", ts->lastSpeed);
+		else
+			printf("%5s", "-");
+		for(c = 0; c < CMD_COUNT; c++)
+			printf(" %8llu", (unsigned long long)ts->cmds[c]);
+		printf("\n");
+	}
+}
@@ -14,6 +14,13 @@
 *	main				contains the beginning of the code.
 *	printMenu			displays a menu of key controls.
 *	setSpeed			prompts the user for setting a train speed.
+*	hornScenario		honks the horn while the train is fast.
+*	patrolScenario		runs the train back and forth.
+*	executeCommand		sends a command to the train.
+*	sendCommand			sends a command to a target.
+*	scenarioCommand		sends a command to a target unless stopped.
+*	reverseCommand		reverses a target keeping its speed unless stopped.
+*	enterCommandPath	locks the command path.
 *******************************************************************************/
 
 #include <stdlib.h>
@@ -22,6 +29,9 @@
 
 #include "base.h"
 #include "target.h"
+#include "trace.h"
+#include "scenario.h"
+#include "telemetry.h"
 
 /* functions declaration */
 /* function for print out options of operation in user interface */
@@ -31,24 +41,68 @@ void setSpeed(void);
 
 /* This function executes the specified command using the data if necessary */
 void executeCommand(target_CmdType_te, uint8_t);
+/* This function sends the specified command to any target */
+void sendCommand(Target_ts*, target_CmdType_te, uint8_t);
+/* This function sends the specified command to any target unless a stop flag
+	is set; it is the command path of the scenario engine */
+int scenarioCommand(Target_ts*, target_CmdType_te, uint8_t, volatile LONG*);
+/* This function reverses any target keeping its speed unless a stop flag is
+	set; it is the reverse path of the scenario engine */
+int reverseCommand(Target_ts*, volatile LONG*);
+/* This function locks the command path, counting the wait as pending in the
+	telemetry page */
+void enterCommandPath(void);
 
 #define THRESHOLD 5
-/* This function honks the horn continuously if the speed is above THRESHOLD */
-DWORD WINAPI hornThread(void*);
+/* This scenario honks the horn continuously if the speed is above THRESHOLD */
+scenario_State_te hornScenario(Scenario_ts*);
+
+#define PATROL_LAPS 3
+#define PATROL_SPD 10
+#define PATROL_RUN_MS 5000
+#define PATROL_WAIT_MS 2000
+/* This scenario runs the train back and forth PATROL_LAPS times, or until
+	the user takes control of the speed */
+scenario_State_te patrolScenario(Scenario_ts*);
+
+/* Maximum number of scenarios running at once */
+#define MAX_SCENARIOS 16
 
 /* define MAX_SPD as maximum speed, 20 */
 #define MAX_SPD 20
 
-/* Reserve space for the base, train, and a lock for them */
+/* Prefix of the frame log every command sent to the base is recorded to */
+#define TRACE_PREFIX "train"
+
+/* Reserve space for the base, train, frame log, telemetry page, and a lock
+	for them */
 static Base_ts base;
 static Target_ts train;
+static Trace_ts trace;
+static Telemetry_ts telemetry;
 static CRITICAL_SECTION critical_section;
 
+/* Reserve space for the scenario engine and the scenarios it runs */
+static Scenario_Engine_ts engine;
+static Scenario_ts horn;
+static Scenario_ts patrol;
+/* Set when the user takes control of the train's speed to stop the
+	patrolScenario */
+static volatile LONG patrol_stop;
+
 /* main function */
 int main(void) {
 	/* Connect to base controller */
 	base_init(&base, "COM1");
 
+	/* Record sent frames for offline analysis; tracing is simply disabled if
+		the log cannot be opened. */
+	trace_open(&trace, TRACE_PREFIX);
+
+	/* Publish live state for external monitors; telemetry is simply disabled
+		if the page cannot be created. */
+	telemetry_open(&telemetry, TELEMETRY_NAME);
+
 	/* Set up train as target with initial speed 0 */
 	uint8_t current_speed = 0;
 	target_init(&train, 23, TRAIN, &current_speed);
@@ -56,10 +110,19 @@ int main(void) {
 	/* Initialize the lock to be used for sending commands 1 at a time */
 	InitializeCriticalSection(&critical_section);
 
-	/* Create a thread to run the hornThread function.  This requires its own
-		thread since it must continual send horn commands to the train even
-		while the main thread is blocked waiting for user input. 			  */
-	CreateThread(NULL, 0, hornThread, NULL, 0, NULL);
+	/* Start the scenario engine and the hornScenario on it.  The engine runs
+		scenarios on its own thread since they must continue to send commands
+		to the train even while the main thread is blocked waiting for user
+		input. 																  */
+	if(scenario_init(&engine, MAX_SCENARIOS, scenarioCommand,
+			reverseCommand)) {
+		DeleteCriticalSection(&critical_section);
+		telemetry_close(&telemetry);
+		trace_close(&trace);
+		base_close(&base);
+		exit(EXIT_FAILURE);
+	}
+	scenario_start(&engine, &horn, hornScenario, &train, NULL, NULL);
 
 	/* print out menu of operation options */
 	printMenu();
@@ -87,22 +150,26 @@ int main(void) {
 			printMenu();
 			break;
 		case '+':
-			/* The train is sent a command to increase its speed by 1. */
-		    if(current_speed < MAX_SPD) {
+			/* The train is sent a command to increase its speed by 1.  The
+				speed is checked under the lock since a scenario may set it. */
+			InterlockedExchange(&patrol_stop, 1);
+			enterCommandPath();
+		    if(current_speed < MAX_SPD)
 				executeCommand(TRAIN_RELSPD, 6);
-				current_speed++;
-			}
+			LeaveCriticalSection(&critical_section);
 			break;
 		case '-':
 			/* The train is sent a command to decrease its speed by 1. */
-		    if(current_speed) {
+			InterlockedExchange(&patrol_stop, 1);
+			enterCommandPath();
+		    if(current_speed)
 				executeCommand(TRAIN_RELSPD, 4);
-				current_speed--;
-			}
+			LeaveCriticalSection(&critical_section);
 			break;
 		case ' ':
 			/* The train is sent a command to use its breaks. This does not set
 				the speed back to 0. */
+			InterlockedExchange(&patrol_stop, 1);
 			executeCommand(TRAIN_BRAKE, 0);
 			break;
 		case 'b':
@@ -120,28 +187,36 @@ int main(void) {
 			break;
 		case 'Q': case 'q':
 			/* This sends a command to terminates the program. */
+			InterlockedExchange(&patrol_stop, 1);
 			executeCommand(SYSTEM_HALT, 0);
 			run = 0;
 			break;
 		case 'h':
 			/* The train is sent a command to set its speed to 0. */
+			InterlockedExchange(&patrol_stop, 1);
 			executeCommand(TRAIN_ABSSPD, 0);
-			current_speed = 0;
 			break;
 		case 't':
 			/* The train is sent a command to toggle its direction. This sets
 				the speed to 0. */
+			InterlockedExchange(&patrol_stop, 1);
 			executeCommand(TRAIN_TOGGLE, 0);
-			current_speed = 0;
 			break;
 		case 'r':
 			/* The train is sent a command to toggle its direction. The original
 				speed is kept. */
-			EnterCriticalSection(&critical_section);
-			target_setCommand(&train, TRAIN_TOGGLE, 0);
-			base_sendData(&base, target_getCommand(&train));
-			target_setCommand(&train, TRAIN_ABSSPD, current_speed);
-			base_sendData(&base, target_getCommand(&train));
+			reverseCommand(&train, NULL);
+			break;
+		case 'p':
+			/* The train is run back and forth by the patrolScenario.  Nothing
+				happens if it is already patrolling, in which case a stop it
+				has not yet seen is kept.  The lock keeps the patrol from
+				checking its stop flag in between. */
+			enterCommandPath();
+			LONG stopped = InterlockedExchange(&patrol_stop, 0);
+			if(scenario_start(&engine, &patrol, patrolScenario, &train, NULL,
+					&patrol_stop) != 0)
+				InterlockedExchange(&patrol_stop, stopped);
 			LeaveCriticalSection(&critical_section);
 			break;
 		default:
@@ -149,9 +224,15 @@ int main(void) {
 			getchar();
 			printMenu();
 		}
+
+		/* The train's state may have changed; wake any waiting scenarios */
+		scenario_notify(&engine);
 	}
 
+	scenario_close(&engine);
 	DeleteCriticalSection(&critical_section);
+	telemetry_close(&telemetry);
+	trace_close(&trace);
 	base_close(&base);
 	exit(EXIT_SUCCESS);
 }
@@ -177,6 +258,7 @@ void printMenu(void) {
 		"2:\tHorn type 2\n"
 		"t:\tToggle Direction\n"
 		"r:\tReverse Speed\n"
+		"p:\tPatrol\n"
 		"h:\tHalt\n"
 		"q:\tQuit\n"
 	);
@@ -200,30 +282,70 @@ void setSpeed(void) {
 	getch();
 
 	spd = spd > MAX_SPD ? MAX_SPD : spd;
-	*(uint8_t*)train.attribute = spd;
+	InterlockedExchange(&patrol_stop, 1);
 	executeCommand(TRAIN_ABSSPD, spd);
 }
 
 /*******************************************************************************
-*	DWORD WINAPI hornThread(void* no_arg)
+*	scenario_State_te hornScenario(Scenario_ts* s)
 *
 *	Description:	Runs in a loop until SYSTEM_HALT command has been set in
-*					train.  Checks the train's current speed is greater than
-*					THRESHOLD and if it is it commands the train to honk.  It
+*					the target.  Waits for the target's current speed to be at
+*					least THRESHOLD and then commands the target to honk.  It
 *					then sleeps for 500 ms.
 *
 *	Parameters:
-*	None
+*	s		The scenario running this routine.
 *
 *******************************************************************************/
-DWORD WINAPI hornThread(void* no_arg) {
-	while(train.bytes[1] != -1 && train.bytes[2] != -1) {
-		if(*(uint8_t*)train.attribute >= THRESHOLD)
-			executeCommand(TRAIN_HORN1, 0);
-		Sleep(500);
+scenario_State_te hornScenario(Scenario_ts* s) {
+	Target_ts* t = s->target;
+
+	SCENARIO_BEGIN(s);
+	while(t->bytes[1] != -1 && t->bytes[2] != -1) {
+		SCENARIO_AWAIT(s, *(uint8_t*)t->attribute >= THRESHOLD ||
+			t->bytes[1] == -1);
+		if(t->bytes[1] == -1)
+			break;
+
+		scenario_command(s, TRAIN_HORN1, 0);
+		SCENARIO_SLEEP(s, 500);
 	}
+	SCENARIO_END(s);
+}
 
-	return 1;
+/*******************************************************************************
+*	scenario_State_te patrolScenario(Scenario_ts* s)
+*
+*	Description:	Runs the target back and forth PATROL_LAPS times.  Each lap
+*					the target honks, runs at PATROL_SPD for PATROL_RUN_MS,
+*					reverses keeping its speed, runs back for PATROL_RUN_MS and
+*					then stops for PATROL_WAIT_MS.  The scenario ends at the
+*					first command skipped because its stop flag is set.  The
+*					flag is checked with the command path locked, so a stop
+*					from the user is never overridden.
+*
+*	Parameters:
+*	s		The scenario running this routine.
+*
+*******************************************************************************/
+scenario_State_te patrolScenario(Scenario_ts* s) {
+	SCENARIO_BEGIN(s);
+	for(s->count = 0; s->count < PATROL_LAPS; s->count++) {
+		if(scenario_command(s, TRAIN_HORN2, 0) ||
+				scenario_setSpeed(s, PATROL_SPD))
+			break;
+		SCENARIO_SLEEP(s, PATROL_RUN_MS);
+
+		if(scenario_reverse(s))
+			break;
+		SCENARIO_SLEEP(s, PATROL_RUN_MS);
+
+		if(scenario_setSpeed(s, 0))
+			break;
+		SCENARIO_SLEEP(s, PATROL_WAIT_MS);
+	}
+	SCENARIO_END(s);
 }
 
 /*******************************************************************************
@@ -231,9 +353,7 @@ DWORD WINAPI hornThread(void* no_arg) {
 *
 *	Description:	Executes the command passed as the first argument and if
 *					necessary the data passed in the second argument.  It does
-*					this by locking the critical section and then issuing the
-*					command to the train and then sending it to the base.  It
-*					finally unlocks the critical section.
+*					this by sending the command to the train with sendCommand.
 *
 *	Parameters:
 *	t	The command to issue to the train.
@@ -242,8 +362,118 @@ DWORD WINAPI hornThread(void* no_arg) {
 *
 *******************************************************************************/
 void executeCommand(target_CmdType_te t, uint8_t d) {
-	EnterCriticalSection(&critical_section);
-	target_setCommand(&train, t, d);
-	base_sendData(&base, target_getCommand(&train));
+	sendCommand(&train, t, d);
+}
+
+/*******************************************************************************
+*	void sendCommand(Target_ts* target, target_CmdType_te t, uint8_t d)
+*
+*	Description:	Sends the command passed as the second argument and if
+*					necessary the data passed in the third argument to the
+*					target passed as the first argument.  It does this by
+*					locking the critical section and then issuing the command
+*					to the target, sending it to the base, recording it in the
+*					frame log and publishing it to the telemetry page.  The
+*					resulting speed is recorded in the target's attribute, if
+*					any.  It finally unlocks the critical section.  The
+*					critical section may already be held by the caller to send
+*					several commands back to back.
+*
+*	Parameters:
+*	target	The target to issue the command to.
+*	t		The command to issue to the target.
+*	d		The data that is necessary for certain commands such as
+*			TRAIN_ABSSPD and TRAIN_RELSPD.
+*
+*******************************************************************************/
+void sendCommand(Target_ts* target, target_CmdType_te t, uint8_t d) {
+	enterCommandPath();
+
+	target_setCommand(target, t, d);
+	int err = base_sendData(&base, target_getCommand(target));
+	trace_record(&trace, target_getCommand(target));
+	telemetry_publish(&telemetry, target, err);
+
+	uint8_t* spd = target->attribute;
+	if(spd != NULL)
+		*spd = target_applySpeed(t, d, *spd);
+	LeaveCriticalSection(&critical_section);
+}
+
+/*******************************************************************************
+*	int scenarioCommand(Target_ts* target, target_CmdType_te t, uint8_t d,
+*		volatile LONG* stop)
+*
+*	Description:	Sends the command to the target with sendCommand unless the
+*					flag stop is set.  The flag is checked with the critical
+*					section held, so a command sent after the flag was set
+*					cannot be overridden.
+*
+*	Parameters:
+*	target	The target to issue the command to.
+*	t		The command to issue to the target.
+*	d		The data for the command.
+*	stop	The flag stopping the command, or NULL.
+*
+*	Returns:
+*	int		0 if the command was sent, 1 if it was stopped.
+*
+*******************************************************************************/
+int scenarioCommand(Target_ts* target, target_CmdType_te t, uint8_t d,
+		volatile LONG* stop) {
+	int ret_val = 1;
+
+	enterCommandPath();
+	if(stop == NULL || !*stop) {
+		sendCommand(target, t, d);
+		ret_val = 0;
+	}
 	LeaveCriticalSection(&critical_section);
+	return ret_val;
+}
+
+/*******************************************************************************
+*	int reverseCommand(Target_ts* target, volatile LONG* stop)
+*
+*	Description:	Toggles the direction of the target passed as the argument,
+*					which stops it, and then restores the speed it had.  Both
+*					commands are sent with the critical section held so that no
+*					other command can come between them.  Nothing is sent if
+*					the flag stop is set.
+*
+*	Parameters:
+*	target	The target to reverse.  Its attribute must point to its speed.
+*	stop	The flag stopping the reverse, or NULL.
+*
+*	Returns:
+*	int		0 if the target was reversed, 1 if it was stopped.
+*
+*******************************************************************************/
+int reverseCommand(Target_ts* target, volatile LONG* stop) {
+	int ret_val = 1;
+
+	enterCommandPath();
+	if(stop == NULL || !*stop) {
+		uint8_t spd = *(uint8_t*)target->attribute;
+		sendCommand(target, TRAIN_TOGGLE, 0);
+		sendCommand(target, TRAIN_ABSSPD, spd);
+		ret_val = 0;
+	}
+	LeaveCriticalSection(&critical_section);
+	return ret_val;
+}
+
+/*******************************************************************************
+*	void enterCommandPath(void)
+*
+*	Description:	Locks the critical section guarding the command path.  The
+*					caller is counted in the pending commands of the telemetry
+*					page while it waits for the lock.  The critical section is
+*					unlocked with LeaveCriticalSection.
+*
+*******************************************************************************/
+void enterCommandPath(void) {
+	telemetry_pending(&telemetry, 1);
+	EnterCriticalSection(&critical_section);
+	telemetry_pending(&telemetry, -1);
 }